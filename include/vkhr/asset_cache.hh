@@ -0,0 +1,94 @@
+#ifndef VKHR_ASSET_CACHE_HH
+#define VKHR_ASSET_CACHE_HH
+
+#include <vkhr/paths.hh>
+
+#include <vkhr/scene_graph/hair_style.hh>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace vkhr {
+    // On-disk store for data we derive from the assets at load time, like
+    // tangents, indices or the voxelized strand volumes. Entries are named
+    // by a key, which is the content hash of the source file plus all the
+    // parameters used to generate them, so stale entries are never found.
+    class AssetCache final {
+    public:
+        AssetCache(const std::string& cache_directory = VKHR_CACHE_PATH);
+
+        // Only hashes the asset if its size or modification time are not
+        // the same as the last time, otherwise the old hash is used again.
+        std::string get_key(const std::string& asset_path, const std::string& parameters) const;
+        std::string get_path(const std::string& key, const std::string& extension) const;
+
+        bool contains(const std::string& key, const std::string& extension) const;
+
+        bool load(const std::string& key, HairStyle& hair_style) const;
+        bool save(const std::string& key, const HairStyle& hair_style) const;
+
+        bool load(const std::string& key, HairStyle::BrickVolume& volume) const;
+        bool save(const std::string& key, const HairStyle::BrickVolume& volume) const;
+
+        bool load(const std::string& key, HairStyle::GuideStrands& guide_strands) const;
+        bool save(const std::string& key, const HairStyle::GuideStrands& guide_strands) const;
+
+        bool load(const std::string& key, HairStyle::SimplifiedStrands& simplified_strands) const;
+        bool save(const std::string& key, const HairStyle::SimplifiedStrands& simplified_strands) const;
+
+        const std::string& get_directory() const;
+
+        // Part of every key, so bump it when an entry's layout (or the
+        // way it's generated, e.g. the voxelizers) changes, and the old
+        // entries are simply not found anymore instead of misread.
+        static constexpr unsigned FormatVersion { 3 };
+
+        // 64-bit FNV-1a, not cryptographic, but good enough for this.
+        static std::uint64_t hash(const char* data, std::size_t size,
+                                  std::uint64_t hash = 14695981039346656037ull);
+
+    private:
+        bool create_directory() const;
+
+        bool hash_asset(const std::string& asset_path, std::uint64_t& content_hash) const;
+
+        // Unique to this process and call, since other processes (or our
+        // own loader threads) could be writing the same entry right now.
+        std::string get_temporary_path(const std::string& key, const std::string& extension) const;
+        bool replace(const std::string& temporary_path, const std::string& path) const;
+
+        struct AssetStamp {
+            char signature[4]; // S, T, M, P.
+            std::uint64_t size;
+            std::int64_t  modified;
+            std::uint64_t content_hash;
+        };
+
+        struct VolumeHeader {
+            char signature[4]; // B, R, I, K.
+            unsigned width, height, depth;
+            AABB bounds;
+            unsigned brick_count;
+            unsigned voxel_count; // stored.
+        };
+
+        struct GuideHeader {
+            char signature[4]; // G, U, I, D.
+            unsigned vertices_per_guide;
+            unsigned guide_count;
+            unsigned strand_count;
+        };
+
+        struct SimplifiedHeader {
+            char signature[4]; // S, I, M, P.
+            float max_error;
+            unsigned strand_count;
+            unsigned segment_count;
+        };
+
+        std::string directory;
+    };
+}
+
+#endif
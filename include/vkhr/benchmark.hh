@@ -2,13 +2,211 @@
 #define VKHR_BENCHMARK_HH
 
 #include <vkhr/rasterizer.hh>
+#include <vkhr/ray_tracer.hh>
+#include <vkhr/scene_graph.hh>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace vkhr {
     class Benchmark final {
     public:
         static void construct(Rasterizer& rasterizer);
+
+        // Times voxelize_segments on every style for 1, 2, 4, ... threads,
+        // and checks that the volume is the same as the one-thread result.
+        // The traversal has to be identical to the brute force Reference,
+        // or this throws. Then it's compared with the sampled voxelizer: all
+        // the voxels sampled should be traversed too (samples are on their
+        // segment), and densities only differ where sampling has skipped or
+        // double counted a voxel. That goes into voxelization_methods.csv.
+        static void voxelization(const SceneGraph& scene_graph, std::size_t resolution = 256);
+
+        // Rays/second of single rays vs. ray packets / streams, for frames
+        // with the same seed, and checks both of them give the same image.
+        static void ray_tracing(Raytracer& ray_tracer, const SceneGraph& scene_graph, std::size_t frames = 16);
     };
 
+    void Benchmark::voxelization(const SceneGraph& scene_graph, std::size_t resolution) {
+        std::filesystem::create_directories("benchmarks/");
+        std::ofstream benchmark_csv { "benchmarks/voxelization.csv" };
+
+        benchmark_csv << std::left;
+        benchmark_csv << std::setw(48) << "Style,"
+                      << std::setw(11) << "Method,"
+                      << std::setw(9)  << "Threads,"
+                      << std::setw(11) << "Time (ms),"
+                      << "Identical" << "\n";
+
+        int max_threads { 1 };
+    #ifdef _OPENMP
+        max_threads = omp_get_max_threads();
+    #endif
+
+        std::ofstream methods_csv { "benchmarks/voxelization_methods.csv" };
+
+        methods_csv << std::left;
+        methods_csv << std::setw(48) << "Style,"
+                    << std::setw(17) << "Sampled Voxels,"
+                    << std::setw(19) << "Traversal Voxels,"
+                    << std::setw(11) << "Coverage,"
+                    << std::setw(15) << "Mean Density,"
+                    << std::setw(21) << "Mean Density Error,"
+                    << "Tangent Agreement" << "\n";
+
+        for (const auto& hair_style : scene_graph.get_hair_styles()) {
+            HairStyle::Volume method_volumes[2]; // Single-threaded results.
+
+            for (auto method : { HairStyle::Voxelization::Sampled, HairStyle::Voxelization::Traversal }) {
+                auto& reference = method_volumes[static_cast<int>(method)];
+
+                for (int threads { 1 }; threads <= max_threads; threads *= 2) {
+                #ifdef _OPENMP
+                    omp_set_num_threads(threads);
+                #endif
+
+                    auto start = std::chrono::steady_clock::now();
+                    auto volume = hair_style.second.voxelize_segments(resolution, resolution, resolution, method);
+                    auto end = std::chrono::steady_clock::now();
+
+                    if (threads == 1) reference = volume;
+
+                    bool identical { volume.densities == reference.densities &&
+                                     volume.tangents  == reference.tangents };
+
+                    auto time = std::chrono::duration<double, std::milli>(end - start).count();
+
+                    benchmark_csv << std::setw(48) << (hair_style.first + ",")
+                                  << std::setw(11) << (method == HairStyle::Voxelization::Sampled ? "Sampled," : "Traversal,")
+                                  << std::setw(9)  << (std::to_string(threads) + ",")
+                                  << std::setw(11) << (std::to_string(time) + ",")
+                                  << (identical ? "yes" : "no") << "\n";
+                }
+            }
+
+            const auto& sampled   = method_volumes[static_cast<int>(HairStyle::Voxelization::Sampled)];
+            const auto& traversal = method_volumes[static_cast<int>(HairStyle::Voxelization::Traversal)];
+
+        #ifdef _OPENMP
+            omp_set_num_threads(max_threads);
+        #endif
+
+            // Any voxel the segment overlaps, tested one by one. Too slow to time.
+            auto reference = hair_style.second.voxelize_segments(resolution, resolution, resolution,
+                                                                 HairStyle::Voxelization::Reference);
+
+            if (traversal.densities != reference.densities || traversal.tangents != reference.tangents)
+                throw std::runtime_error { "Voxel traversal of " + hair_style.first + " doesn't match the reference!" };
+
+            std::size_t sampled_voxels { 0 }, traversal_voxels { 0 }, covered_voxels { 0 },
+                        occupied_voxels { 0 }, agreeing_tangents { 0 };
+            double density_sum { 0.0 }, density_error { 0.0 };
+
+            for (std::size_t i { 0 }; i < sampled.densities.size(); ++i) {
+                const int sampled_density   { sampled.densities[i] },
+                          traversal_density { traversal.densities[i] };
+
+                if (sampled_density   != 0) ++sampled_voxels;
+                if (traversal_density != 0) ++traversal_voxels;
+
+                if (sampled_density != 0 && traversal_density != 0) {
+                    ++covered_voxels;
+
+                    glm::vec3 sampled_tangent   { sampled.tangents[i].x,   sampled.tangents[i].y,   sampled.tangents[i].z },
+                              traversal_tangent { traversal.tangents[i].x, traversal.tangents[i].y, traversal.tangents[i].z };
+
+                    // Tangents are averages, so only their directions should match.
+                    if (glm::dot(sampled_tangent, traversal_tangent) >= 0.9f * glm::length(sampled_tangent) * glm::length(traversal_tangent))
+                        ++agreeing_tangents;
+                }
+
+                if (sampled_density != 0 || traversal_density != 0) {
+                    ++occupied_voxels;
+                    density_sum   += traversal_density;
+                    density_error += std::abs(sampled_density - traversal_density);
+                }
+            }
+
+            auto ratio = [](double numerator, std::size_t denominator) {
+                return denominator != 0 ? numerator / denominator : 1.0;
+            };
+
+            methods_csv << std::setw(48) << (hair_style.first + ",")
+                        << std::setw(17) << (std::to_string(sampled_voxels) + ",")
+                        << std::setw(19) << (std::to_string(traversal_voxels) + ",")
+                        << std::setw(11) << (std::to_string(ratio(covered_voxels, sampled_voxels)) + ",")
+                        << std::setw(15) << (std::to_string(ratio(density_sum, occupied_voxels)) + ",")
+                        << std::setw(21) << (std::to_string(ratio(density_error, occupied_voxels)) + ",")
+                        << ratio(agreeing_tangents, covered_voxels) << "\n";
+        }
+
+    #ifdef _OPENMP
+        omp_set_num_threads(max_threads);
+    #endif
+    }
+
+    void Benchmark::ray_tracing(Raytracer& ray_tracer, const SceneGraph& scene_graph, std::size_t frames) {
+        std::filesystem::create_directories("benchmarks/");
+        std::ofstream benchmark_csv { "benchmarks/ray_tracing.csv" };
+
+        benchmark_csv << std::left;
+        benchmark_csv << std::setw(12) << "Mode,"
+                      << std::setw(8)  << "Frames,"
+                      << std::setw(13) << "Time (ms),"
+                      << std::setw(12) << "Rays,"
+                      << std::setw(13) << "Mrays/s,"
+                      << "Identical" << "\n";
+
+        auto tracing_mode = ray_tracer.get_tracing_mode();
+        auto seed = ray_tracer.get_seed();
+
+        std::vector<unsigned char> reference;
+
+        for (auto mode : { Raytracer::TracingMode::SingleRays, Raytracer::TracingMode::RayPackets }) {
+            ray_tracer.set_tracing_mode(mode);
+            ray_tracer.set_seed(seed); // restarts accumulation too.
+
+            std::size_t rays { 0 };
+
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t frame { 0 }; frame < frames; ++frame) {
+                ray_tracer.draw(scene_graph);
+                rays += ray_tracer.get_ray_count();
+            }
+            auto end = std::chrono::steady_clock::now();
+
+            auto& framebuffer = ray_tracer.get_framebuffer();
+            std::vector<unsigned char> image(framebuffer.get_data(),
+                                             framebuffer.get_data() + framebuffer.get_size_in_bytes());
+
+            if (mode == Raytracer::TracingMode::SingleRays) reference = image;
+
+            bool identical { image == reference };
+
+            auto time = std::chrono::duration<double, std::milli>(end - start).count();
+            auto mrays_per_second = rays / (time * 1000.0);
+
+            benchmark_csv << std::setw(12) << (mode == Raytracer::TracingMode::SingleRays ? "Single," : "Packets,")
+                          << std::setw(8)  << (std::to_string(frames) + ",")
+                          << std::setw(13) << (std::to_string(time) + ",")
+                          << std::setw(12) << (std::to_string(rays) + ",")
+                          << std::setw(13) << (std::to_string(mrays_per_second) + ",")
+                          << (identical ? "yes" : "no") << "\n";
+        }
+
+        ray_tracer.set_tracing_mode(tracing_mode);
+        ray_tracer.set_seed(seed);
+    }
+
     void Benchmark::construct(Rasterizer& rasterizer) {
         vkhr::Rasterizer::Benchmark default_parameter {
             "Benchmark Scenario", // Description
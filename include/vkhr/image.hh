@@ -6,6 +6,7 @@
 #include <vector>
 #include <utility>
 #include <string>
+#include <cstdint>
 
 namespace vkhr {
     using Color = glm::tvec4<unsigned char>;
@@ -66,6 +67,9 @@ namespace vkhr {
         void clear(const Color& color);
 
         void copy(const std::vector<glm::dvec3>& floating_point_data, double samples);
+        // Same as above, but each pixel was accumulated with its own count.
+        void copy(const std::vector<glm::dvec3>& floating_point_data,
+                  const std::vector<std::uint32_t>& samples);
 
         // TODO: support bilinear and bicubic interpolation later.
         void resize(const unsigned width, const unsigned height);
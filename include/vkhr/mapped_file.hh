@@ -0,0 +1,44 @@
+#ifndef VKHR_MAPPED_FILE_HH
+#define VKHR_MAPPED_FILE_HH
+
+#include <string>
+#include <cstddef>
+
+namespace vkhr {
+    // Read-only memory mapping of a whole file. Pages are only faulted in
+    // when touched, and they are backed by the file itself, so they don't
+    // count against the process' anonymous memory (and can be evicted).
+    class MappedFile final {
+    public:
+        MappedFile() = default;
+        MappedFile(const std::string& file_path);
+        ~MappedFile() noexcept;
+
+        MappedFile(MappedFile&& mapped_file) noexcept;
+        MappedFile& operator=(MappedFile&& mapped_file) noexcept;
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        friend void swap(MappedFile& lhs, MappedFile& rhs);
+
+        bool open(const std::string& file_path);
+        void close();
+
+        operator bool() const;
+
+        const char* get_data() const;
+        std::size_t get_size() const;
+
+    private:
+        const char* data { nullptr };
+        std::size_t size { 0 };
+
+    #ifdef WINDOWS
+        void* file_handle    { nullptr };
+        void* mapping_handle { nullptr };
+    #endif
+    };
+}
+
+#endif
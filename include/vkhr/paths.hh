@@ -8,7 +8,14 @@
 // e.g. shared path could be: /usr/share/vkhr/
 // need to supply SHARED_PATH at compile time!
 
+// Under the assets, like everything else, unless it's given explicitly
+// (e.g. if the shared path above is read-only, like in /usr/share/vkhr).
+#ifndef VKHR_CACHE_PATH
+#define VKHR_CACHE_PATH VKHR_ASSETS_PATH "cache/"
+#endif
+
 #define ASSET(PATH)  VKHR_ASSETS_PATH PATH
+#define CACHE(PATH)  VKHR_CACHE_PATH PATH
 
 #define IMAGE(PATH)  ASSET("images/"  PATH)
 #define MODEL(PATH)  ASSET("models/"  PATH)
@@ -34,6 +34,12 @@ namespace vkhr {
         void load(const SceneGraph& scene) override;
         void update(const SceneGraph& scene_graphs);
 
+        // After a hair style's strands have changed (e.g. simulated with
+        // HairStyle::set_strand_vertices), this re-voxelizes and uploads
+        // only the dirty strands, and the volume bricks they've touched.
+        // Returns false if it's not in the scene. See the Raytracer's too.
+        bool update_hair_style(const HairStyle& hair_style);
+
         std::uint32_t fetch_next_frame();
 
         void draw(const SceneGraph& scene) override;
@@ -45,6 +51,9 @@ namespace vkhr {
         void draw_hairs(const SceneGraph& scene_graph, Pipeline& pipeline, vk::CommandBuffer& command_buffer, glm::mat4 = glm::mat4 { 1.0f });
         void voxelize(const SceneGraph& a_scene_graph, vk::CommandBuffer& command_buffer);
 
+        // Expands the guide strands into the styles' strands. Only done when they're loaded, since the guides don't move.
+        void interpolate();
+
         // Direct Volume Render (DVR) the hair strands. This needs to be done after drawing models and styles.
         void strand_dvr(const SceneGraph& scene_graph, Pipeline& pipeline, vk::CommandBuffer& command_buffer);
 
@@ -117,6 +126,7 @@ namespace vkhr {
         Pipeline hair_depth_pipeline;
         Pipeline mesh_depth_pipeline;
         Pipeline hair_voxel_pipeline;
+        Pipeline hair_guide_pipeline;
 
         Pipeline strand_dvr_pipeline;
         Pipeline ppll_blend_pipeline;
@@ -29,6 +29,13 @@ namespace vkhr {
             void load(const vkhr::HairStyle& hair_style,
                       vkhr::Rasterizer& scene_renderer);
 
+            // Uploads the strands that are marked as dirty, and the bricks
+            // of the volume that changed when they were re-voxelized. The
+            // first time the whole volume is re-voxelized, so it has the
+            // counts to subtract the strands from later (see DynamicVolume).
+            void update(const vkhr::HairStyle& hair_style,
+                        vkhr::Rasterizer& vulkan_renderer);
+
             void voxelize(Pipeline& voxelization_pipeline, vk::DescriptorSet& descriptor_set, vk::CommandBuffer& command_buffer);
             void draw_volume(Pipeline& volume_pipeline,    vk::DescriptorSet& descriptor_set, vk::CommandBuffer& command_buffer);
 
@@ -39,6 +46,15 @@ namespace vkhr {
             static void build_pipeline(Pipeline& pipeline_reference, Rasterizer& vulkan_renderer);
             static void depth_pipeline(Pipeline& pipeline_reference, Rasterizer& vulkan_renderer);
             static void voxel_pipeline(Pipeline& pipeline_reference, Rasterizer& vulkan_renderer);
+            static void guide_pipeline(Pipeline& pipeline_reference, Rasterizer& vulkan_renderer);
+
+            // If the scene graph made guides for the style, only they (and
+            // the weights and offsets) are uploaded, and the strands in the
+            // vertex buffers are expanded from them by interpolate() when
+            // it's loaded or updated, since they don't move between frames.
+            bool has_guide_strands() const;
+
+            void interpolate(Pipeline& guide_pipeline, vk::DescriptorSet& descriptor_set, vk::CommandBuffer& command_buffer);
 
             void update_parameters();
 
@@ -55,15 +71,39 @@ namespace vkhr {
                 float strand_ratio;
             } parameters;
 
+            // Picks the closest level of detail to the strand_ratio, which
+            // is also done by update_parameters() (e.g. from the UI). It's
+            // just a smaller draw, and thicker and more opaque strands.
             void reduce(float ratio);
 
+            // Draws the coarsest simplified style within max_error of the
+            // strands, e.g. the size of a pixel at the camera's distance.
+            void simplify(float max_error);
+
         private:
+            const vkhr::HairStyle* pointer { nullptr };
+
+            vkhr::HairStyle::LevelOfDetail level_of_detail;
+
             vk::IndexBuffer  segments;
             vk::VertexBuffer vertices;
             vk::VertexBuffer tangents;
             vk::VertexBuffer thickness;
 
-            vk::ImageView density_view;
+            // Only the indices, the vertices are the same as the above.
+            struct SimplifiedGeometry {
+                const vkhr::HairStyle::SimplifiedStrands* pointer;
+
+                vk::IndexBuffer segments;
+
+                unsigned segment_count; // in the current level of detail.
+            };
+
+            std::vector<SimplifiedGeometry> simplified_geometry;
+            int simplified_level { -1 }; // i.e. the original strands.
+
+            vk::ImageView density_view; // all mips
+            vk::ImageView density_storage_view;
             vk::DeviceImage density_volume;
             vk::Sampler density_sampler;
 
@@ -73,6 +113,26 @@ namespace vkhr {
 
             vk::UniformBuffer parameter_buffer;
 
+            vk::StorageBuffer strand_offsets;
+            vk::StorageBuffer guide_vertices;
+            vk::StorageBuffer guided_strands;
+
+            std::uint32_t guided_strand_count { 0 };
+            std::uint32_t vertices_per_guide { 0 };
+
+            // False if there are no guides, or the shader isn't built, and
+            // then the original strands are uploaded in the vertex buffers.
+            bool load_guide_strands(const vkhr::HairStyle& hair_style,
+                                    vkhr::Rasterizer& vulkan_renderer);
+
+            // Creates the density pyramid and tangent volume from this. The
+            // images are sparse only if it's asked for, and it's supported.
+            void upload_volume(vkhr::HairStyle::Volume& strand_volume,
+                               vk::DeviceImage::Residency residency,
+                               vkhr::Rasterizer& vulkan_renderer);
+
+            vkhr::HairStyle::DynamicVolume dynamic_volume; // if updated.
+
             Volume volume;
 
             std::size_t segments_per_strand;
@@ -2,20 +2,48 @@
 #define VKHR_RAY_TRACER_HH
 
 #include <vkhr/renderer.hh>
+#include <vkhr/image.hh>
 
 #include <vkhr/ray_tracer/model.hh>
 #include <vkhr/ray_tracer/hair_style.hh>
 #include <vkhr/ray_tracer/ray.hh>
+#include <vkhr/ray_tracer/sampler.hh>
 
 #include <embree3/rtcore.h>
 
+#include <atomic>
+#include <memory>
 #include <random>
 
 namespace vkhr {
     class Interface;
     class Raytracer final : public Renderer {
     public:
+        // How Embree builds the BVH of each hair style, which trades build
+        // time and memory against tracing speed. Flat curves are ribbons
+        // facing the ray, B-splines are smooth, but they need 4 vertices a
+        // segment, so their ends stop one segment short of a strand's ends.
+        struct BuildOptions {
+            enum class Curve {
+                FlatLinear,
+                FlatBSpline,
+                RoundBSpline
+            };
+
+            Curve curve { Curve::FlatLinear };
+            RTCBuildQuality quality { RTC_BUILD_QUALITY_MEDIUM };
+
+            bool compact { false }; // less memory, but slower to trace.
+            bool robust  { false }; // watertight, but slower to trace.
+
+            unsigned threads { 0 }; // Embree's, or all of them for zero.
+            bool verbose { false };
+
+            RTCSceneFlags get_scene_flags() const;
+        };
+
         Raytracer(const SceneGraph& scene_graph);
+        Raytracer(const SceneGraph& scene_graph, const BuildOptions& build_options);
 
         ~Raytracer() noexcept;
 
@@ -24,13 +52,28 @@ namespace vkhr {
 
         glm::vec3 light_shading(const Ray& ray, const Camera& camera,
                                 const LightSource& light,
-                                RTCIntersectContext& context);
-        float ambient_occlusion(const glm::vec3& point, RTCIntersectContext& context);
+                                OcclusionContext& context,
+                                SampleSequence& sample_sequence);
+        float ambient_occlusion(const Ray& ray, OcclusionContext& context,
+                                SampleSequence& sample_sequence);
 
         Raytracer(Raytracer&& raytracer) noexcept;
         Raytracer& operator=(Raytracer&& raytracer) noexcept;
         friend void swap(Raytracer& lhs, Raytracer& rhs);
 
+        // After a hair style's vertices have changed (e.g. simulated), this
+        // refits or rebuilds its BVH, updates its instances and restarts the
+        // image. Returns false if it's not in the scene or has been rebuilt.
+        bool update_hair_style(const HairStyle& hair_style);
+
+        const BuildOptions& get_build_options() const;
+
+        // For the build statistics, e.g. get_build_time or get_memory_usage.
+        const std::vector<embree::HairStyle>& get_hair_styles() const;
+
+        // Bytes which are allocated by Embree right now, by all the scenes.
+        std::size_t get_memory_usage() const;
+
         void toggle_shadows();
 
         Image& get_framebuffer();
@@ -41,6 +84,44 @@ namespace vkhr {
 
         void recreate(unsigned width, unsigned height);
 
+        // The same seed gives the same image, regardless of the threads.
+        void set_seed(std::uint32_t seed);
+        std::uint32_t get_seed() const;
+
+        // The pixel jitter, light jitter and AO directions all come from it.
+        void set_sampler(Sampler::Type sampler_type);
+        Sampler::Type get_sampler_type() const;
+
+        // Pixels are traced in tiles of TileSize², handed out one by one
+        // to whichever thread is done with its last one (i.e. balanced).
+        static constexpr int TileSize { 16 };
+
+        // Either trace each pixel sample's rays one by one, or trace all of
+        // the primary rays in a tile as packets, and then all of its shadow
+        // and AO rays as streams. Both give the same image for some seed.
+        enum class TracingMode {
+            SingleRays,
+            RayPackets
+        };
+
+        void set_tracing_mode(TracingMode tracing_mode);
+        TracingMode get_tracing_mode() const;
+
+        // Number of rays (primary, shadow and AO) traced in the last draw.
+        std::size_t get_ray_count() const;
+
+        // Adaptive sampling: a pixel stops getting new samples after it has
+        // at least minimum_samples, and the standard error of its luminance
+        // is below target_error. A target of zero samples every pixel. The
+        // error is never less than 3/n though (the rule of three), so that
+        // pixels where every sample was the same aren't done after a few,
+        // as a thin strand covering a part of them could have been missed.
+        void set_target_error(float target_error, std::size_t minimum_samples = 16);
+        float get_target_error() const;
+
+        std::size_t get_converged_pixel_count() const;
+        bool is_converged() const; // i.e. all of them.
+
         enum VisualizationMethod {
             Shaded           = 0,
             CombinedShadows  = 1,
@@ -48,14 +129,68 @@ namespace vkhr {
             AmbientOcclusion = 3
         };
 
+        void set_visualization_method(VisualizationMethod visualization_method);
+        VisualizationMethod get_visualization_method() const;
+
     private:
         void set_flush_to_zero();
         void set_denormal_zero();
 
+        std::size_t trace_rays(const glm::ivec2& tile_begin, const glm::ivec2& tile_end,
+                               const Camera& camera, const LightSource& light);
+        std::size_t trace_packets(const glm::ivec2& tile_begin, const glm::ivec2& tile_end,
+                                  const Camera& camera, const LightSource& light);
+
+        Ray create_primary_ray(int i, int j, const Camera& camera, SampleSequence& sample_sequence);
+        Ray create_shadow_ray(const Ray& ray, const LightSource& light, SampleSequence& sample_sequence);
+        Ray create_ambient_ray(const Ray& ray, SampleSequence& sample_sequence);
+
+        bool hit_hair_style(const Ray& ray) const;
+
+        // One instance per node and hair style (or model), which refers to
+        // its scene, so moving a node only updates the instance transform,
+        // and styles shared by many nodes still only build their BVH once.
+        struct Instance {
+            enum class Type {
+                HairStyle,
+                Model
+            };
+
+            const SceneGraph::Node* node { nullptr };
+            Type type { Type::HairStyle };
+            std::size_t index { 0 }; // in hair_styles or models.
+
+            glm::mat4 model_matrix  { 1.0f };
+            glm::mat3 normal_matrix { 1.0f };
+
+            void set_model_matrix(const glm::mat4& model_matrix);
+        };
+
+        void add_instance(const SceneGraph::Node& node, Instance::Type type, std::size_t index);
+        void update_instances(const SceneGraph& scene_graph);
+
+        std::vector<Instance> instances; // by the geometry ID.
+        std::size_t transform_revision { 0 };
+
+        bool casts_shadow_rays() const;
+        // The light visibility is the shadow ray's transmittance through hair.
+        glm::vec3 shade(const Ray& ray, const Camera& camera, const LightSource& light, float light_visibility);
+
+        void accumulate(std::size_t pixel, const glm::dvec3& sample_color);
+
         bool shadows_on { true };
         bool now_dirty { false };
 
         VisualizationMethod visualization_method { Shaded };
+        TracingMode tracing_mode { TracingMode::SingleRays };
+
+        std::size_t ray_count { 0 };
+
+        BuildOptions build_options;
+
+        // Allocations are counted by Embree's memory monitor callback, and
+        // this is on the heap so that it's still there if we're moved from.
+        std::unique_ptr<std::atomic<std::ptrdiff_t>> memory_usage;
 
         mutable RTCDevice device { nullptr };
         mutable RTCScene  scene  { nullptr };
@@ -65,14 +200,19 @@ namespace vkhr {
 
         std::vector<glm::dvec3> back_buffer;
 
-        std::uint32_t seed { 0 };
-        float sample(float min,  float max);
-        std::uint32_t xorshift();
+        // Running sums to estimate each pixel's variance. The sample counts
+        // are per-pixel, since converged pixels don't get any more samples.
+        std::vector<double>        luminance_squares;
+        std::vector<std::uint32_t> sample_counts;
+        std::vector<std::uint8_t>  converged;
+
+        float target_error { 0.0f };
+        std::size_t minimum_samples { 16 };
+        std::size_t converged_pixels { 0 };
 
-        // "Correlated Multi-Jittered Sampling":
-        float rand_float(unsigned i, unsigned p);
-        unsigned permute(unsigned i, unsigned l, unsigned p);
-        glm::vec2 cmj(int s, int m, int n, int p);
+        // Samples only depend on the seed, pixel and its sample index, so
+        // the threads don't share (and race on) anything, nor does the order.
+        std::unique_ptr<Sampler> sampler;
 
         Image framebuffer;
 
@@ -9,9 +9,12 @@
 
 #include <embree3/rtcore.h>
 
+#include <cstddef>
 #include <vector>
 
+#ifndef VKHR_HEADLESS
 #include <vkhr/rasterizer/hair_style.hh>
+#endif
 
 namespace vkhr {
     class Raytracer;
@@ -23,18 +26,66 @@ namespace vkhr {
             HairStyle(const vkhr::HairStyle& hair_style, const vkhr::Raytracer& raytracer);
             void load(const vkhr::HairStyle& hair_style, const vkhr::Raytracer& raytracer);
 
+            ~HairStyle() noexcept;
+
+            HairStyle(HairStyle&& hair_style) noexcept;
+            HairStyle& operator=(HairStyle&& hair_style) noexcept;
+            friend void swap(HairStyle& lhs, HairStyle& rhs);
+
             glm::vec3 shade(const Ray& surface_intersection,
                             const LightSource& light_source,
                             const Camera& projection_camera) override;
+            // For a hit on an instance of the style, which was placed in the
+            // world by model_matrix (the hit is in the instance's own space).
+            glm::vec3 shade(const Ray& surface_intersection,
+                            const LightSource& light_source,
+                            const Camera& projection_camera,
+                            const glm::mat4& model_matrix);
             glm::vec4 get_tangent(const Ray& position) const;
 
             unsigned get_geometry() const;
 
+            // Each style has its own scene (i.e. BVH) which is only built once,
+            // and is then instanced into the top-level scene, once per node.
+            RTCScene get_scene() const;
+
+            // Rewrites the vertices in place (e.g. after a simulation step)
+            // and refits the BVH, which is a lot faster than building it,
+            // but gets worse the further the strands move from where it was
+            // built. When the mean vertex displacement since then is above
+            // refit_threshold segment lengths, the BVH is built again. If the
+            // vertex count changed, the whole geometry is created again too.
+            // Returns true if the BVH was refitted, and false if it was built.
+            bool update(const vkhr::HairStyle& hair_style, const vkhr::Raytracer& raytracer);
+
+            void set_refit_threshold(float refit_threshold);
+            float get_refit_threshold() const;
+
+            std::size_t get_refit_count() const; // since the last build.
+
+            // How long the last BVH build (or refit) took in milliseconds, and
+            // how much memory Embree has allocated for the style's BVH.
+            float get_build_time() const;
+            std::size_t get_memory_usage() const;
+
+            std::size_t get_segment_count() const; // i.e. curves in Embree.
+
+            // Shadow rays pass through strands, which each let 1 - opacity of
+            // the light through, until there's less than this much left, so a
+            // ray goes through at most log(MinimumTransmittance) / log(1 - a).
+            static constexpr float MinimumTransmittance { 0.01f };
+
+        #ifndef VKHR_HEADLESS
             void update_parameters(const vkhr::vulkan::HairStyle& hair_style);
+        #endif
 
             const vkhr::HairStyle* get_pointer() const;
 
         private:
+            void commit(const vkhr::Raytracer& raytracer);
+
+            static void occlusion_filter(const RTCFilterFunctionNArguments* arguments);
+
             glm::vec3 kajiya_kay(const glm::vec3& diffuse,
                                  const glm::vec3& specular,
                                  float p,
@@ -52,6 +103,27 @@ namespace vkhr {
             float     hair_exponent;
 
             std::vector<glm::vec4> position_thickness;
+
+            float refit_threshold { 0.5f };
+            std::size_t refit_count { 0 };
+
+            // Where the vertices were when the BVH was last built. These are
+            // only kept once the style has been updated, i.e. it's moving.
+            std::vector<glm::vec3> built_vertices;
+            float mean_segment_length { 0.0f };
+
+            // Only used by the B-splines, the line segments use the style's.
+            std::vector<unsigned> curve_indices;
+            std::size_t segment_count { 0 };
+
+            RTCBuildQuality build_quality { RTC_BUILD_QUALITY_MEDIUM };
+
+            // From the style's per-vertex transparency if it has any, or the
+            // default one (like the rasterizer). The filter gets its pointer.
+            std::vector<float> segment_opacity;
+
+            float build_time { 0.0f };
+            std::ptrdiff_t memory_usage { 0 };
         };
     }
 }
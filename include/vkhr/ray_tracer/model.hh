@@ -5,6 +5,10 @@
 
 #include <vkhr/ray_tracer/shadable.hh>
 
+#include <glm/glm.hpp>
+
+#include <embree3/rtcore.h>
+
 namespace vkhr {
     class Raytracer;
     namespace embree {
@@ -15,24 +19,44 @@ namespace vkhr {
 
             Model() = default;
 
+            ~Model() noexcept;
+
+            Model(Model&& model) noexcept;
+            Model& operator=(Model&& model) noexcept;
+            friend void swap(Model& lhs, Model& rhs);
+
             unsigned get_geometry() const;
 
+            // Like the hair styles, each model has its own scene which is
+            // instanced into the top-level scene once for every node of it.
+            RTCScene get_scene() const;
+
+            const vkhr::Model* get_pointer() const;
+
+            glm::vec3 shade(const Ray& surface_intersection,
+                            const LightSource& light_source,
+                            const Camera& projection_camera) override;
+            // For a hit on an instance, where normal_matrix takes the normal
+            // from the instance's space (where the hit is) to world space.
             glm::vec3 shade(const Ray& surface_intersection,
                             const LightSource& light_source,
-                            const Camera& projection_camera);
+                            const Camera& projection_camera,
+                            const glm::mat3& normal_matrix);
+            glm::vec3 get_normal(const Ray& position) const;
+
         private:
-            glm::vec3 blinn_phong(const glm::vec3& diffuse,
-                                  const glm::vec3& specular,
-                                  float shininess,
-                                  const glm::vec3& normal,
-                                  const glm::vec3& light,
-                                  const glm::vec3& eye);
+            // Same as the rasterizer's model.frag, so that they can be compared.
+            glm::vec3 lambertian(const glm::vec3& diffuse,
+                                 const glm::vec3& normal,
+                                 const glm::vec3& light);
 
             RTCScene scene { nullptr };
 
+            const vkhr::Model* pointer { nullptr };
+
             unsigned geometry { RTC_INVALID_GEOMETRY_ID };
         };
     }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -5,21 +5,31 @@
 
 #include <glm/glm.hpp>
 
+#include <limits>
+#include <vector>
+
 namespace vkhr {
     class Ray final {
     public:
         Ray(const glm::vec3& origin,
             const glm::vec3& direction,
-            float near_plane_t_value);
+            float near_plane_t_value,
+            float far_plane_t_value = std::numeric_limits<float>::infinity());
 
         static constexpr float Epsilon { 0.000001f };
 
+        // Rays per rtcIntersect8 packet. Assumes that Embree was built with
+        // AVX (for SSE it'll split them into two packets of width four).
+        static constexpr std::size_t PacketSize { 8 };
+
         glm::vec3 get_origin() const;
         glm::vec3 get_direction() const;
 
         RTCRay& get_ray();
         RTCHit& get_hit();
 
+        void set_id(unsigned id); // e.g. its index in a stream.
+
         bool hit_surface() const;
         bool is_occluded() const;
 
@@ -32,6 +42,7 @@ namespace vkhr {
 
         unsigned get_primitive_id() const;
         unsigned get_geometry_id()  const;
+        unsigned get_instance_id()  const; // in the top-level scene.
         bool hit_geometry(unsigned) const;
 
         glm::vec3 get_intersection_point() const;
@@ -40,9 +51,39 @@ namespace vkhr {
         bool occluded_by(RTCScene& scene, RTCIntersectContext& context);
         bool occluded_by(RTCScene& scene, RTCIntersectContext& context, float radius);
 
+        // Coherent rays (e.g. primary rays in a tile) are traced as packets
+        // of PacketSize, and incoherent ones (shadows / AO) as a ray stream,
+        // Embree then re-orders the stream into packets by itself, if able.
+        static void intersect_packets(std::vector<Ray>& rays, RTCScene& scene, RTCIntersectContext& context);
+        static void occluded_by_stream(std::vector<Ray>& rays, RTCScene& scene, RTCIntersectContext& context);
+
     private:
         RTCRayHit ray_hit { };
     };
+
+    // Light left along a shadow ray, and the last few strand segments that
+    // it went through. Embree can report the same segment more than once,
+    // e.g. when it's in several leaves after spatial splits, or both where
+    // a ray enters and exits a round curve, which mustn't be counted twice.
+    struct Transmittance {
+        float value { 1.0f };
+
+        static constexpr unsigned RecentHits { 8 };
+
+        glm::uvec2 recent_hits[RecentHits]; // (instance, primitive) IDs.
+        unsigned hit_count { 0 };
+
+        bool add_hit(const glm::uvec2& hit); // false if it's a repeat.
+    };
+
+    // Embree hands the context to the filter functions as it is, so this is
+    // how shadow rays pass on where to accumulate their transmittance. Any
+    // occlusion query against hair needs one, with transmittance null for
+    // rays where any hit should occlude them (e.g. ambient occlusion rays).
+    struct OcclusionContext {
+        RTCIntersectContext context;
+        Transmittance* transmittance { nullptr }; // by the ray's ID.
+    };
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+#ifndef VKHR_EMBREE_SAMPLER_HH
+#define VKHR_EMBREE_SAMPLER_HH
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vkhr {
+    // Samples in [0, 1)^2 for a pixel, its sample index, and the dimension
+    // (i.e. which random decision in the path it's for). These only depend
+    // on the arguments and the seed, so they can be drawn in any thread or
+    // order, and different dimensions are decorrelated by scrambling them.
+    class Sampler {
+    public:
+        Sampler(std::uint32_t seed);
+        virtual ~Sampler() noexcept = default;
+
+        virtual glm::vec2 get_2d(const glm::uvec2& pixel, std::uint32_t sample_index,
+                                 std::uint32_t dimension) const = 0;
+
+        void set_seed(std::uint32_t seed);
+        std::uint32_t get_seed() const;
+
+        enum class Type {
+            Random,
+            CorrelatedMultiJittered,
+            Sobol,
+            BlueNoise
+        };
+
+        static std::unique_ptr<Sampler> create(Type type, std::uint32_t seed);
+
+        virtual Type get_type() const = 0;
+
+        // "lowbias32" by Chris Wellons, so that neighbouring pixels and samples
+        // end up with seemingly unrelated states (unlike with a plain xorshift).
+        static std::uint32_t hash(std::uint32_t value);
+        static std::uint32_t hash(std::uint32_t a, std::uint32_t b, std::uint32_t c);
+
+        static float to_float(std::uint32_t bits);
+
+        // Maps [0, 1)^2 to directions on the unit sphere / hemisphere around
+        // the normal, where the hemisphere is cosine-weighted (for the AO).
+        static glm::vec3 uniform_sphere(const glm::vec2& sample);
+        static glm::vec3 cosine_hemisphere(const glm::vec2& sample, const glm::vec3& normal);
+
+    protected:
+        std::uint32_t seed;
+    };
+
+    // Hashed white noise, like the old xorshift. Only for comparisons.
+    class RandomSampler final : public Sampler {
+    public:
+        using Sampler::Sampler;
+        glm::vec2 get_2d(const glm::uvec2& pixel, std::uint32_t sample_index,
+                         std::uint32_t dimension) const override;
+        Type get_type() const override;
+    };
+
+    // "Correlated Multi-Jittered Sampling" by Kensler, using patterns of
+    // PatternSize^2 samples, with a new pattern for each set of samples.
+    class CmjSampler final : public Sampler {
+    public:
+        using Sampler::Sampler;
+        glm::vec2 get_2d(const glm::uvec2& pixel, std::uint32_t sample_index,
+                         std::uint32_t dimension) const override;
+        Type get_type() const override;
+
+        static constexpr std::uint32_t PatternSize { 16 };
+
+    private:
+        static float rand_float(unsigned i, unsigned p);
+        static unsigned permute(unsigned i, unsigned l, unsigned p);
+        static glm::vec2 cmj(int s, int m, int n, int p);
+    };
+
+    // The first two Sobol dimensions with "Practical Hash-based Owen
+    // Scrambling" by Burley, with the index and each dimension scrambled
+    // using a different seed per pixel and dimension (i.e. decorrelated).
+    class SobolSampler final : public Sampler {
+    public:
+        using Sampler::Sampler;
+        glm::vec2 get_2d(const glm::uvec2& pixel, std::uint32_t sample_index,
+                         std::uint32_t dimension) const override;
+        Type get_type() const override;
+
+        static std::uint32_t sobol(std::uint32_t index, std::uint32_t dimension);
+        static std::uint32_t nested_uniform_scramble(std::uint32_t x, std::uint32_t seed);
+    };
+
+    // Sobol samples which are the same for all pixels, but which are then
+    // toroidally shifted by a void-and-cluster blue-noise mask tiled over
+    // the screen. Pixel errors become blue noise, which isn't as visible.
+    class BlueNoiseSampler final : public Sampler {
+    public:
+        using Sampler::Sampler;
+        glm::vec2 get_2d(const glm::uvec2& pixel, std::uint32_t sample_index,
+                         std::uint32_t dimension) const override;
+        Type get_type() const override;
+
+        static constexpr std::uint32_t MaskSize { 64 };
+
+        // Ranks of the pixels in the mask, normalized to [0, 1). It's only
+        // generated once, on first use (~100 ms for a MaskSize of 64).
+        static const std::vector<float>& get_mask();
+
+    private:
+        static std::vector<float> void_and_cluster(int size, float sigma);
+    };
+
+    // Consecutive dimensions of a single pixel sample, so every decision
+    // that's taken (pixel jitter, light jitter, AO...) gets its own one.
+    class SampleSequence final {
+    public:
+        SampleSequence(const Sampler& sampler, const glm::uvec2& pixel,
+                       std::uint32_t sample_index);
+
+        glm::vec2 next_2d();
+        float     next_1d();
+
+    private:
+        const Sampler* sampler;
+        glm::uvec2 pixel;
+        std::uint32_t sample_index;
+        std::uint32_t dimension { 0 };
+    };
+}
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef VKHR_SCENE_GRAPH_HH
 #define VKHR_SCENE_GRAPH_HH
 
+#include <vkhr/asset_cache.hh>
+
 #include <vkhr/scene_graph/model.hh>
 #include <vkhr/scene_graph/light_source.hh>
 #include <vkhr/scene_graph/hair_style.hh>
@@ -27,6 +29,10 @@ namespace vkhr {
 
         void traverse_nodes();
 
+        // Bumped by traverse_nodes() when any node's model matrix changed,
+        // so that renderers can tell when they need to update transforms.
+        std::size_t get_transform_revision() const;
+
         bool load(const std::string& scene_path);
 
         HairStyle& add_style(const std::string& asset_path);
@@ -57,6 +63,10 @@ namespace vkhr {
 
         const std::string& get_scene_path() const;
 
+        // The "guides" in the scene, if the rasterizer should interpolate
+        // its strands from that many guide strands. Zero if it shouldn't.
+        unsigned get_guide_count() const;
+
         void cleanup();
 
         class Node final {
@@ -112,7 +122,7 @@ namespace vkhr {
 
             mutable bool recalculate_transform { true };
 
-            mutable glm::mat4 model_matrix;
+            mutable glm::mat4 model_matrix { 1.0f };
 
             std::vector<Node*> children;
             std::vector<HairStyle*> hair_styles;
@@ -172,6 +182,17 @@ namespace vkhr {
         bool parse_light(nlohmann::json& parser,  LightSource& light);
         bool parse_node(nlohmann::json& parser,   Node& node, int i);
 
+        // Loads every asset in the scene in parallel before parse_node().
+        void load_assets(nlohmann::json& parser);
+
+        HairStyle load_style(const std::string& path, const std::string& cache_key) const;
+        Model     load_model(const std::string& path) const;
+
+        // Simplifies (or loads) the levels for style_simplification_errors.
+        void simplify_style(HairStyle& hair_style, const std::string& cache_key) const;
+        // Clusters (or loads) the guides if the scene has any "guides".
+        void load_guide_strands(HairStyle& hair_style, const std::string& cache_key) const;
+
         void build_node_cache(Node& chnode);
         void destroy_previous_node_caches();
 
@@ -190,9 +211,21 @@ namespace vkhr {
         std::unordered_map<std::string, HairStyle> hair_styles;
         std::unordered_map<std::string, Model> models;
 
+        // Styles with the same contents but under different paths are only
+        // loaded once, the other paths are just aliases of the first path.
+        std::unordered_map<std::string, std::string> style_aliases;
+        std::unordered_map<std::string, std::string> style_contents;
+
         std::size_t unique_name { 0 };
         std::string scene_path { "" };
 
+        unsigned guide_count { 0 };
+
+        std::size_t transform_revision { 0 };
+        bool transforms_changed { false };
+
+        AssetCache asset_cache;
+
         mutable Error error_state {
             Error::None
         };
@@ -5,7 +5,9 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
 
+#ifndef VKHR_HEADLESS
 #include <vkhr/input_map.hh>
+#endif
 
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -45,6 +47,9 @@ namespace vkhr {
         void  set_field_of_view(const float field_of_view);
         float get_field_of_view() const;
 
+        // World-space height of a pixel at that distance from the camera.
+        float get_pixel_size(float distance) const;
+
         const glm::vec3& get_position() const;
         void set_position(const glm::vec3& position);
         void set_look_at_point(const glm::vec3& look_at_point);
@@ -53,7 +58,9 @@ namespace vkhr {
         const glm::vec3& get_up_direction() const;
 
         void pan_relative_to(const glm::vec2& mouse_movement);
+    #ifndef VKHR_HEADLESS
         void control(InputMap& input_map, const float delta_time, const bool imgui_focused);
+    #endif
         void arcball_relative_to(const glm::vec2& mouse_movement);
 
         void look_at(const glm::vec3& point, const glm::vec3& eye,
@@ -7,10 +7,16 @@
 
 #include <glm/gtx/component_wise.hpp>
 
+#include <vkhr/mapped_file.hh>
+#include <vkhr/span.hh>
+
 #include <string>
 #include <fstream>
+#include <memory>
 #include <vector>
 #include <array>
+#include <cstring>
+#include <cstdint>
 
 namespace vkhr {
     struct AABB {
@@ -23,12 +29,13 @@ namespace vkhr {
     class HairStyle final {
     public:
         HairStyle() = default;
-        HairStyle(const std::string& file_path);
+        HairStyle(const std::string& file_path, const bool memory_mapped = false);
 
         enum class Error {
             None,
 
             OpeningFile,
+            MappingFile,
             ReadingFileHeader,
             WritingFileHeader,
 
@@ -59,6 +66,20 @@ namespace vkhr {
         bool load(const std::string& file_path);
         bool save(const std::string& file_path) const;
 
+        // Writes the quantized .hairz sibling format, which is loaded by
+        // load() just like any other file (we look at the signature). It
+        // stores positions as 16-bit delta encoded offsets in the AABB's
+        // grid, octahedral tangents, and 8-bit thickness/transparencies.
+        bool save_compressed(const std::string& file_path) const;
+
+        // Maps the file instead of reading it, the attribute arrays are
+        // then viewed in-place until something wants to modify them, in
+        // which case the materialize() call copies them to the vectors.
+        bool map(const std::string& file_path);
+
+        bool is_mapped() const;
+        void materialize();
+
         unsigned get_strand_count() const;
         void set_strand_count(const unsigned strand_count);
         unsigned get_segment_count() const;
@@ -96,21 +117,246 @@ namespace vkhr {
             void normalize();
             bool save(const std::string& f_path);
 
+            // Halves each dimension (rounding down, but never below 1), by
+            // reducing every 2³ block of densities with the given filter.
+            // On odd dimensions the last block is 3 voxels wide, so nothing
+            // gets dropped.
             template<typename F>
-            Volume downsample(F);
+            Volume downsample(F filter) const;
+
+            // All levels after this one down to 1³, i.e. the rest of the
+            // mip chain. With average it's the density pyramid. The GPU's
+            // voxelization rebuilds the same levels from its own volume.
+            template<typename F>
+            std::vector<Volume> create_mip_chain(F filter) const;
+
+            std::size_t get_mip_levels() const; // including this one.
+
+            static unsigned char average(Span<unsigned char> neighborhood);
+        };
+
+        // Sampled takes unit steps along the segment's major axis, which is
+        // fast but may skip or double count voxels. Traversal visits every
+        // voxel a segment passes through exactly once (Amanatides and Woo).
+        // Reference tests each voxel in a segment's bounds for an overlap,
+        // which is very slow, but it's only there to check the Traversal.
+        enum class Voxelization {
+            Sampled,
+            Traversal,
+            Reference
+        };
+
+        // Sparse Volume, which only stores the 8³ bricks that have strands
+        // in them. The brick_table maps brick (x, y, z) to where it is in
+        // the brick pool, or it's an EmptyBrick. Strands are thin, so most
+        // voxels in a brick are still empty: each brick has a bitmask of
+        // its non-empty voxels, and only those are stored in densities and
+        // tangents, starting at the brick's voxel_offsets and in the order
+        // of their bits (the same x + y * 8 + z * 64 as in a dense brick).
+        struct BrickVolume {
+            static constexpr int BrickSize { 8 };
+            static constexpr int MaskWords { BrickSize * BrickSize * BrickSize / 64 };
+            static constexpr unsigned EmptyBrick { 0xffffffff };
+
+            glm::vec3 resolution;
+            AABB bounds; // world
+
+            glm::ivec3 brick_grid;
+            std::vector<unsigned> brick_table;
+
+            std::vector<std::uint64_t> occupancy; // MaskWords per brick.
+            std::vector<unsigned> voxel_offsets;
+
+            std::vector<unsigned char> densities;
+            std::vector<glm::i8vec4>    tangents;
+
+            // Recounts the voxel_offsets from the occupancy, e.g. after
+            // it's been loaded, and returns the number of stored voxels.
+            std::size_t generate_voxel_offsets();
+
+            unsigned char get_density(const glm::ivec3& voxel) const;
+            glm::i8vec4   get_tangent(const glm::ivec3& voxel) const;
+
+            std::size_t get_brick_count() const;
+            std::size_t get_size() const;
+
+            void normalize();
+
+            // For the GPU, which still wants a dense 3-D image.
+            Volume to_dense() const;
+
+        private:
+            std::size_t get_brick_index(const glm::ivec3& voxel) const;
+            std::size_t get_voxel_index(const glm::ivec3& voxel) const;
+
+            // Where the voxel is in densities and tangents, or npos.
+            std::size_t find_voxel(const glm::ivec3& voxel) const;
+            static constexpr std::size_t npos { static_cast<std::size_t>(-1) };
+        };
+
+        // For strands that move, e.g. when simulated. Each voxel keeps a
+        // 32-bit count and a fixed-point tangent sum, so a strand can be
+        // subtracted exactly before it's added back at its new position.
+        // Only the 8³ bricks that have been touched by a strand are kept.
+        // The 8-bit volume is refreshed in the voxels that were changed.
+        struct DynamicVolume {
+            static constexpr float TangentScale { 1024.0f };
+
+            Volume volume;
+            Voxelization method;
+
+            glm::ivec3 brick_grid;
+            std::vector<unsigned> brick_table;
+
+            std::vector<unsigned>   densities;
+            std::vector<glm::ivec3> tangents;
+
+            // Counts become 8-bit densities with this, see normalize().
+            float density_scale { 1.0f };
+
+            // Where the strands were the last time they were voxelized.
+            std::vector<glm::vec3> voxelized_vertices;
+            std::vector<glm::vec3> voxelized_tangents;
+
+            // Voxels of the 8-bit volume changed by the last revoxelize(),
+            // sorted, so a renderer only has to upload the bricks of these.
+            std::vector<std::size_t> changed_voxels;
+
+            // Scales the densest voxel to 255, like Volume::normalize(). It
+            // is kept that way, so a strand that moves gets the same scale.
+            void normalize();
+
+            void refresh_voxel(std::size_t voxel);
+
+            std::size_t get_size() const;
         };
 
         Volume voxelize_vertices(std::size_t width, std::size_t height, std::size_t depth) const;
-        Volume voxelize_segments(std::size_t width, std::size_t height, std::size_t depth) const;
+        Volume voxelize_segments(std::size_t width, std::size_t height, std::size_t depth,
+                                 Voxelization method = Voxelization::Sampled) const;
+        BrickVolume voxelize_bricks(std::size_t width, std::size_t height, std::size_t depth,
+                                    Voxelization method = Voxelization::Sampled) const;
+        DynamicVolume voxelize_dynamic(std::size_t width, std::size_t height, std::size_t depth,
+                                       Voxelization method = Voxelization::Sampled) const;
+
+        // Only re-voxelizes the strands marked as dirty since they've been
+        // cleared. The marks are kept, since other renderers may need them
+        // too: clear_dirty_strands() once they've all been updated. Returns
+        // the number of strands that had to be voxelized again. If the vertex
+        // count changed, the whole volume is rebuilt instead.
+        std::size_t revoxelize(DynamicVolume& dynamic_volume) const;
+
+        // Moves a strand, e.g. after simulating it, and regenerates its
+        // tangents. It's marked as dirty, so that revoxelize() and renderers
+        // only have to redo the strands that moved, like a swinging ponytail.
+        // The vertex count must be the strand's own (nothing happens if not).
+        void set_strand_vertices(unsigned strand, Span<glm::vec3> strand_vertices);
+
+        // Call these after changing a strand's vertices some other way.
+        void mark_strand_dirty(unsigned strand);
+        void mark_strands_dirty();
+        bool is_strand_dirty(unsigned strand) const;
+        std::size_t get_dirty_strand_count() const;
+        const std::vector<unsigned>& get_dirty_strands() const;
+        void clear_dirty_strands();
 
         void shuffle();
         void reduce(float ratio);
 
+        // Nested levels of detail: each level is the first strand_count
+        // strands, and is spread out evenly over the style, so a renderer
+        // can switch between them by just drawing less of the same data.
+        // Dropped strands are compensated for by making the rest thicker
+        // and more opaque (alpha' = 1 - (1 - alpha)^opacity_exponent).
+        struct LevelOfDetail {
+            float strand_ratio;
+            unsigned strand_count;
+            unsigned segment_count;
+            float thickness_scale;
+            float opacity_exponent;
+        };
+
+        // Sorts the strands into lod_levels nested levels (which are in a
+        // Morton order inside them). generate_lod_chain() only builds the
+        // table, for styles that are already in that order (e.g. cached).
+        void build_lod_chain(unsigned lod_levels = 64);
+        void generate_lod_chain(unsigned lod_levels = 64);
+
+        const std::vector<LevelOfDetail>& get_lod_chain() const;
+        LevelOfDetail get_level_of_detail(float strand_ratio) const;
+
+        // Douglas-Peucker on each strand: vertices are removed as long as
+        // the strand stays within max_error (in world units) of them. For
+        // a screen-space tolerance use Camera::get_pixel_size(distance).
+        // It only picks which of our vertices are kept, so the result is
+        // just segment indices into the style's own vertices, tangents and
+        // thickness, and a renderer can share those between all of them.
+        // The tangents are the original ones, not along the new segments,
+        // but those are within max_error of the strand there in any case.
+        struct SimplifiedStrands {
+            float max_error { 0.0f };
+
+            std::vector<unsigned> indices; // two per segment, like get_indices().
+            std::vector<unsigned> segment_offsets; // prefix sum, one per strand + 1.
+
+            // Strands are in the same order, so the levels are still nested.
+            unsigned get_segment_count(unsigned strand_count) const;
+            std::size_t get_size() const;
+        };
+
+        SimplifiedStrands simplify(float max_error) const;
+
+        // Levels for every tolerance, sorted from the finest to coarsest. As
+        // simplify() keeps the strand order they have the same lod_chain,
+        // just fewer segments in each level, and so they can be used along
+        // with it: strand_ratio up close and max_error far off in a scene.
+        void set_simplified_lods(std::vector<SimplifiedStrands> simplified_strands);
+
+        const std::vector<SimplifiedStrands>& get_simplified_lods() const;
+
+        // Strands clustered into guides by k-means on their shape, i.e. the
+        // strand resampled to vertices_per_guide points (evenly by vertex,
+        // which is how it's interpolated back too). Each strand is a blend
+        // of its GuidesPerStrand closest guides, plus an offset moving the
+        // blended root onto its own. Only the guides need to be simulated,
+        // the strands are then expanded from them, on the CPU or the GPU.
+        struct GuideStrands {
+            static constexpr unsigned GuidesPerStrand { 4 };
+
+            unsigned vertices_per_guide { 0 };
+            std::vector<glm::vec3> vertices; // guide after guide.
+
+            std::vector<glm::uvec4> guides; // for each strand.
+            std::vector<glm::vec4> weights; // which sum to one.
+            std::vector<glm::vec3> offsets;
+
+            unsigned get_guide_count() const;
+            std::size_t get_size() const;
+
+            // The vertex of a strand with vertex_count vertices in total, as
+            // it's done by the rasterizer's interpolate.comp compute shader.
+            glm::vec3 interpolate(std::size_t strand, std::size_t vertex, std::size_t vertex_count) const;
+        };
+
+        // The first guide_count strands are the initial guides, which are
+        // spread out evenly over the style if it's in the LOD chain order.
+        GuideStrands create_guide_strands(unsigned guide_count, unsigned vertices_per_guide = 16,
+                                          unsigned iterations = 8) const;
+
+        // Guides made when the style was loaded (e.g. the scene has asked
+        // for them), so renderers don't have to cluster them on their own.
+        const GuideStrands& get_guide_strands() const;
+        void set_guide_strands(GuideStrands guide_strands);
+
         void generate_thickness(float radius);
 
         const char* get_information() const;
         void set_information(const std::string& information);
 
+        // Identifies the derived data in the AssetCache, if it was cached.
+        const std::string& get_cache_key() const;
+        void set_cache_key(const std::string& cache_key);
+
         void generate_tangents();
 
         // In case we need to pack the data (raytracer and alignment).
@@ -120,26 +366,23 @@ namespace vkhr {
 
         void generate_indices();
 
-        // Let the user do what he pleases with the hair data.
-        // Consistency with arrays is checked upon file write.
+        // Prefix sum of the vertices per strand, i.e. strand i's vertices
+        // are in [strand_offsets[i], strand_offsets[i + 1]). It's computed
+        // on load and after reduce(), the generators above rely on it too.
+        void generate_strand_offsets();
 
-        std::vector<unsigned short> segments;
-        std::vector<glm::vec3> vertices;
-        std::vector<float> thickness;
-        std::vector<float> transparency;
-        std::vector<glm::vec3> color;
+        const std::vector<unsigned>& get_strand_offsets() const;
 
-        const std::vector<float>& get_thickness() const;
-        const std::vector<glm::vec3>& get_vertices() const;
-        const std::vector<unsigned short>& get_segments() const;
-        const std::vector<float>& get_transparency() const;
-        const std::vector<glm::vec3>& get_color() const;
+        // These will view the mapped file if it's still around.
 
-        std::vector<glm::vec3> tangents;
-        std::vector<unsigned>  indices;
+        Span<float> get_thickness() const;
+        Span<glm::vec3> get_vertices() const;
+        Span<unsigned short> get_segments() const;
+        Span<float> get_transparency() const;
+        Span<glm::vec3> get_color() const;
 
-        const std::vector<glm::vec3>& get_tangents() const;
-        const std::vector<unsigned>&  get_indices()  const;
+        Span<glm::vec3> get_tangents() const;
+        Span<unsigned>  get_indices()  const;
 
         std::size_t get_size() const;
 
@@ -173,7 +416,51 @@ namespace vkhr {
             float    bounding_box_max[3];
         } file_header;
 
+        // Only used if the style isn't mapped, or once materialize() has
+        // copied the mapped fields over, so go through the spans above.
+        // Consistency with arrays is checked upon file write.
+
+        std::vector<unsigned short> segments;
+        std::vector<glm::vec3> vertices;
+        std::vector<float> thickness;
+        std::vector<float> transparency;
+        std::vector<glm::vec3> color;
+        std::vector<glm::vec3> tangents;
+        std::vector<unsigned>  indices;
+
+        std::vector<unsigned> strand_offsets;
+
+        bool strand_offsets_valid() const;
+
+        void generate_strand_tangents(std::size_t strand);
+
+        std::vector<std::uint32_t> create_root_morton_codes() const;
+        static std::vector<unsigned> sort_strands(const std::vector<std::uint64_t>& sort_keys);
+        static std::vector<unsigned> create_lod_residues(unsigned lod_levels);
+        void permute_strands(const std::vector<unsigned>& order);
+
+        std::vector<LevelOfDetail> lod_chain;
+
+        std::vector<SimplifiedStrands> simplified_lods;
+
+        GuideStrands guide_strands;
+
+        void accumulate_strand(DynamicVolume& dynamic_volume, std::size_t strand,
+                               const glm::vec3* vertices, const glm::vec3* tangents,
+                               int weight, std::vector<std::size_t>* changed_voxels) const;
+
+        std::vector<unsigned char> strand_dirty;
+        std::vector<unsigned> dirty_strands;
+
+        std::vector<std::vector<unsigned>> bin_segments(const glm::vec3& resolution, const AABB& bounds,
+                                                        std::size_t slab_depth) const;
+        void voxelize_slab(const glm::vec3& resolution, const AABB& bounds,
+                           const std::vector<unsigned>& segments,
+                           int slab_begin, int slab_end, Voxelization method,
+                           unsigned char* densities, glm::vec3* precise_tangents) const;
+
         bool valid_signature() const;
+        bool compressed_signature() const;
         bool format_is_valid() const;
 
         void complete_header() const;
@@ -187,6 +474,12 @@ namespace vkhr {
         template<typename T>
         bool read_field(std::ifstream& file, std::vector<T>& field);
 
+        template<typename T>
+        bool map_field(std::size_t& offset, std::size_t count,
+                       std::vector<T>& field, Span<T>& mapped_field);
+
+        void release_mapping();
+
         bool read_segments(std::ifstream& file);
         bool read_vertices(std::ifstream& file);
         bool read_thickness(std::ifstream& file);
@@ -195,8 +488,18 @@ namespace vkhr {
         bool read_tangents(std::ifstream& file);
         bool read_indices(std::ifstream& file);
 
+        struct CompressedHeader {
+            unsigned version;
+            unsigned position_bytes;
+            float    thickness_scale;
+        };
+
+        static constexpr unsigned CompressedVersion { 1 };
+
+        bool read_compressed(std::ifstream& file);
+
         template<typename T>
-        bool write_field(std::ofstream& file, const std::vector<T>& field) const;
+        bool write_field(std::ofstream& file, const Span<T>& field) const;
 
         bool write_segments(std::ofstream& file) const;
         bool write_vertices(std::ofstream& file) const;
@@ -207,6 +510,18 @@ namespace vkhr {
         bool write_indices(std::ofstream& file) const;
 
         mutable Error error_state { Error::None };
+
+        std::string cache_key;
+
+        std::shared_ptr<const MappedFile> mapped_file;
+
+        Span<unsigned short> mapped_segments;
+        Span<glm::vec3> mapped_vertices;
+        Span<float> mapped_thickness;
+        Span<float> mapped_transparency;
+        Span<glm::vec3> mapped_color;
+        Span<glm::vec3> mapped_tangents;
+        Span<unsigned> mapped_indices;
     };
 
     template<typename T>
@@ -218,7 +533,33 @@ namespace vkhr {
     }
 
     template<typename T>
-    bool HairStyle::write_field(std::ofstream& file, const std::vector<T>& field) const {
+    bool HairStyle::map_field(std::size_t& offset, std::size_t count,
+                              std::vector<T>& field, Span<T>& mapped_field) {
+        field.clear();
+        mapped_field = Span<T> { };
+
+        std::size_t size_in_bytes { count * sizeof(T) };
+
+        if (offset + size_in_bytes > mapped_file->get_size())
+            return false; // The file is truncated.
+
+        const char* data { mapped_file->get_data() + offset };
+
+        offset += size_in_bytes;
+
+        // Fields after the segments may be misaligned, so copy those.
+        if (reinterpret_cast<std::uintptr_t>(data) % alignof(T) != 0) {
+            field.resize(count);
+            std::memcpy(field.data(), data, size_in_bytes);
+        } else {
+            mapped_field = Span<T> { reinterpret_cast<const T*>(data), count };
+        }
+
+        return true;
+    }
+
+    template<typename T>
+    bool HairStyle::write_field(std::ofstream& file, const Span<T>& field) const {
         if (!file.write(reinterpret_cast<const char*>(field.data()),
                         field.size() * sizeof(field[0])))
             return false;
@@ -226,35 +567,61 @@ namespace vkhr {
     }
 
     template<typename F>
-    HairStyle::Volume HairStyle::Volume::downsample(F filter) {
+    HairStyle::Volume HairStyle::Volume::downsample(F filter) const {
+        glm::ivec3 grid        = resolution;
+        glm::ivec3 volume_grid = glm::max(grid / 2, glm::ivec3 { 1 });
+
         Volume volume {
-            resolution / 2.00f,
+            glm::vec3 { volume_grid },
             bounds // no change
         };
 
-        volume.densities.resize(volume.resolution.x * volume.resolution.y * volume.resolution.z, 0);
+        volume.densities.resize(volume_grid.x * volume_grid.y * volume_grid.z, 0);
 
-        glm::ivec3 grid        = resolution;
-        glm::ivec3 volume_grid = volume.resolution;
+        // Each slice writes its own voxels, so no synchronization needed.
+        #pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < volume_grid.z; ++k)
+        for (int j = 0; j < volume_grid.y; ++j)
+        for (int i = 0; i < volume_grid.x; ++i) {
+            glm::ivec3 block { i, j, k };
+            glm::ivec3 begin = 2 * block;
+            glm::ivec3 end   = glm::min(begin + 2, grid);
 
-        for (int k = 0; k < volume.resolution.z; ++k)
-        for (int j = 0; j < volume.resolution.y; ++j)
-        for (int i = 0; i < volume.resolution.x; ++i) {
-            std::array<unsigned char, 8> neighborhood;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (block[axis] == volume_grid[axis] - 1)
+                    end[axis] = grid[axis]; // the odd remainder.
+            }
+
+            std::array<unsigned char, 27> neighborhood;
+            std::size_t neighbors { 0 };
 
-            for (int z = 0; z < 2; ++z)
-            for (int y = 0; y < 2; ++y)
-            for (int x = 0; x < 2; ++x) {
-                neighborhood[x + 2*y + 4*z] = densities[(2*i + x) + (2*j + y)*grid.x + (2*k + z)*grid.x*grid.y];
+            for (int z = begin.z; z < end.z; ++z)
+            for (int y = begin.y; y < end.y; ++y)
+            for (int x = begin.x; x < end.x; ++x) {
+                neighborhood[neighbors++] = densities[x + y*grid.x + static_cast<std::size_t>(z)*grid.x*grid.y];
             }
 
-            std::size_t index = i + j*volume_grid.x + k*volume_grid.x*volume_grid.y;
+            std::size_t index = i + j*volume_grid.x + static_cast<std::size_t>(k)*volume_grid.x*volume_grid.y;
 
-            volume.densities[index] = filter(neighborhood);
+            volume.densities[index] = filter(Span<unsigned char> { neighborhood.data(), neighbors });
         }
 
         return volume;
     }
+
+    template<typename F>
+    std::vector<HairStyle::Volume> HairStyle::Volume::create_mip_chain(F filter) const {
+        std::vector<Volume> mip_chain;
+        mip_chain.reserve(get_mip_levels() - 1);
+
+        const Volume* level { this };
+        while (glm::compMax(glm::ivec3 { level->resolution }) > 1) {
+            mip_chain.push_back(level->downsample(filter));
+            level = &mip_chain.back(); // reserved, so no dangling.
+        }
+
+        return mip_chain;
+    }
 }
 
 #endif
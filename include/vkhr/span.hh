@@ -0,0 +1,83 @@
+#ifndef VKHR_SPAN_HH
+#define VKHR_SPAN_HH
+
+#include <cstddef>
+#include <vector>
+
+namespace vkhr {
+    // Read-only view over a contiguous array that we don't own, e.g. a
+    // std::vector or some memory mapped file. Just a C++17 std::span.
+    template<typename T>
+    class Span final {
+    public:
+        Span() = default;
+        Span(const T* data, std::size_t size);
+        Span(const std::vector<T>& vector);
+
+        const T* data() const;
+        std::size_t size() const;
+        bool empty() const;
+
+        const T* begin() const;
+        const T* end()   const;
+
+        const T& operator[](std::size_t i) const;
+
+        const T& front() const;
+        const T& back()  const;
+
+    private:
+        const T* pointer { nullptr };
+        std::size_t count { 0 };
+    };
+
+    template<typename T>
+    Span<T>::Span(const T* data, std::size_t size)
+                 : pointer { data }, count { size } {  }
+
+    template<typename T>
+    Span<T>::Span(const std::vector<T>& vector)
+                 : pointer { vector.data() }, count { vector.size() } {  }
+
+    template<typename T>
+    const T* Span<T>::data() const {
+        return pointer;
+    }
+
+    template<typename T>
+    std::size_t Span<T>::size() const {
+        return count;
+    }
+
+    template<typename T>
+    bool Span<T>::empty() const {
+        return count == 0;
+    }
+
+    template<typename T>
+    const T* Span<T>::begin() const {
+        return pointer;
+    }
+
+    template<typename T>
+    const T* Span<T>::end() const {
+        return pointer + count;
+    }
+
+    template<typename T>
+    const T& Span<T>::operator[](std::size_t i) const {
+        return pointer[i];
+    }
+
+    template<typename T>
+    const T& Span<T>::front() const {
+        return pointer[0];
+    }
+
+    template<typename T>
+    const T& Span<T>::back() const {
+        return pointer[count - 1];
+    }
+}
+
+#endif
@@ -2,10 +2,13 @@
 #define VKHR_VKHR_HH
 
 #include <vkhr/arg_parser.hh>
+#include <vkhr/asset_cache.hh>
 #include <vkhr/image.hh>
 #include <vkhr/paths.hh>
 #include <vkhr/window.hh>
 #include <vkhr/input_map.hh>
+#include <vkhr/mapped_file.hh>
+#include <vkhr/span.hh>
 #include <vkhr/renderer.hh>
 
 #include <vkhr/scene_graph.hh>
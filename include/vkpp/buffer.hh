@@ -104,6 +104,21 @@ namespace vkpp {
                      std::uint32_t binding = 0,
                      const std::vector<Attribute> attributes = {});
 
+        template<typename T>
+        VertexBuffer(Device& device,
+                     CommandPool& command_buffer,
+                     const T* vertices,
+                     std::size_t vertex_count,
+                     std::uint32_t binding = 0,
+                     const std::vector<Attribute> attributes = {});
+
+        // Left uninitialized, e.g. to be written by a compute shader.
+        VertexBuffer(Device& device,
+                     std::size_t vertex_count,
+                     VkDeviceSize vertex_size,
+                     std::uint32_t binding = 0,
+                     const std::vector<Attribute> attributes = {});
+
         std::uint32_t get_binding_id() const;
 
         const VkVertexInputBindingDescription& get_binding() const;
@@ -134,6 +149,11 @@ namespace vkpp {
                     CommandPool& command_buffer,
                     const std::vector<unsigned>& indices);
 
+        IndexBuffer(Device& device,
+                    CommandPool& command_buffer,
+                    const unsigned* indices,
+                    std::size_t index_count);
+
         VkIndexType get_type() const;
 
         std::uint32_t count() const;
@@ -271,10 +291,24 @@ namespace vkpp {
                                const std::vector<T>& vertices,
                                std::uint32_t binding,
                                const std::vector<Attribute> attributes)
-                              : DeviceBuffer { device,
+                              : VertexBuffer { device,
                                                command_buffer,
                                                vertices.data(),
-                                               sizeof(vertices[0]) * vertices.size(),
+                                               vertices.size(),
+                                               binding,
+                                               attributes } {  }
+
+    template<typename T>
+    VertexBuffer::VertexBuffer(Device& device,
+                               CommandPool& command_buffer,
+                               const T* vertices,
+                               std::size_t vertex_count,
+                               std::uint32_t binding,
+                               const std::vector<Attribute> attributes)
+                              : DeviceBuffer { device,
+                                               command_buffer,
+                                               vertices,
+                                               sizeof(T) * vertex_count,
                                                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT } {
         this->attributes.reserve(attributes.size());
@@ -285,9 +319,9 @@ namespace vkpp {
                                          attribute.offset });
         }
 
-        this->element_count = vertices.size();
+        this->element_count = vertex_count;
 
-        this->binding = { binding, sizeof(vertices[0]), VK_VERTEX_INPUT_RATE_VERTEX };
+        this->binding = { binding, sizeof(T), VK_VERTEX_INPUT_RATE_VERTEX };
     }
 
     template<typename T>
@@ -53,6 +53,11 @@ namespace vkpp {
                               VkImageMemoryBarrier image_memory_barrier);
 
         void blit_image(Image& source, Image& destination, VkFilter filter);
+
+        // Downsamples each level into the next, starting at the first one,
+        // with a barrier between them. The image stays in its own layout,
+        // so it has to be one that can be both blitted to and from.
+        void blit_mip_chain(Image& image, VkFilter filter);
         void copy_image(Image& source, Image& destination);
 
         void fill_buffer(Buffer& buffer, VkDeviceSize offset, VkDeviceSize size, std::uint32_t data);
@@ -62,6 +67,14 @@ namespace vkpp {
                          std::uint32_t source_offset = 0,
                          std::uint32_t destination_offset = 0);
         void copy_buffer_image(Buffer& source, Image& destination);
+        void copy_buffer_image(Buffer& source, Image& destination,
+                               VkDeviceSize offset, std::uint32_t mip_level);
+
+        // Several parts at once, e.g. only the ones that have changed.
+        void copy_buffer(Buffer& source, Buffer& destination,
+                         const std::vector<VkBufferCopy>& regions);
+        void copy_buffer_image(Buffer& source, Image& destination,
+                               const std::vector<VkBufferImageCopy>& regions);
 
         void begin_render_pass(RenderPass& render_pass,
                                vkhr::vulkan::DepthMap&);
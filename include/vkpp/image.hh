@@ -10,6 +10,7 @@
 
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 namespace vkpp {
     class Queue;
@@ -27,7 +28,8 @@ namespace vkpp {
               std::uint32_t depth, VkFormat format, VkImageUsageFlags usage,
               std::uint32_t mip_levels = 1,
               VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
-              VkImageTiling tiling_mode = VK_IMAGE_TILING_OPTIMAL);
+              VkImageTiling tiling_mode = VK_IMAGE_TILING_OPTIMAL,
+              VkImageCreateFlags flags = 0);
 
         Image(Device& device, std::uint32_t width, std::uint32_t height,
               VkFormat format, VkImageUsageFlags usage,
@@ -100,6 +102,19 @@ namespace vkpp {
     public:
         DeviceImage() = default;
 
+        // Sparse volumes only get memory for the image blocks that have a
+        // non-zero texel in them, and the rest reads as zero. The GPU page
+        // table does the brick lookups, so shaders sample them like usual.
+        enum class Residency {
+            Full,
+            Sparse
+        };
+
+        // Needs the sparse features, a queue that can bind the memory, and
+        // unbound blocks that are guaranteed to read as zero (i.e. strict).
+        static bool sparse_residency_supported(Device& device, CommandPool& command_pool,
+                                               VkFormat format, VkImageUsageFlags usage);
+
         friend void swap(DeviceImage& lhs, DeviceImage& rhs);
         DeviceImage& operator=(DeviceImage&& image) noexcept;
         DeviceImage(DeviceImage&& image) noexcept;
@@ -122,7 +137,16 @@ namespace vkpp {
                     std::uint32_t width, std::uint32_t height, std::uint32_t depth,
                     CommandPool& command_pool,
                     std::vector<glm::i8vec4>& volume,
-                    std::uint32_t mip_levels = 1);
+                    std::uint32_t mip_levels = 1,
+                    Residency residency = Residency::Full);
+
+        // Uploads every level of a volume's mip chain, the first one being
+        // the full resolution volume, in a single staging buffer and copy.
+        DeviceImage(Device& device,
+                    std::uint32_t width, std::uint32_t height, std::uint32_t depth,
+                    CommandPool& command_pool,
+                    std::vector<std::vector<unsigned char>>& volume_mip_chain,
+                    Residency residency = Residency::Full);
 
         DeviceImage(Device& device,
                     std::uint32_t width, std::uint32_t height, std::uint32_t depth,
@@ -141,6 +165,15 @@ namespace vkpp {
         void staged_copy(std::vector<unsigned char>& volume, CommandBuffer& command_buffer);
 
     private:
+        static constexpr VkImageCreateFlags SparseFlags { VK_IMAGE_CREATE_SPARSE_BINDING_BIT |
+                                                          VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT };
+
+        // Binds and uploads the non-empty blocks of each tightly packed
+        // level, and the whole mip tail, if the image has one.
+        void sparse_upload(Device& device, CommandPool& command_pool,
+                           const std::vector<const unsigned char*>& levels,
+                           VkDeviceSize texel_size);
+
         Buffer       staging_buffer;
         DeviceMemory staging_memory;
 
@@ -152,7 +185,8 @@ namespace vkpp {
         ImageView() = default;
 
         ImageView(VkDevice& device, VkImageView& image, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        ImageView(Device& device,     Image& image,     VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        ImageView(Device& device,     Image& image,     VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                  std::uint32_t mip_levels = 1);
 
         ~ImageView() noexcept;
 
@@ -38,6 +38,8 @@ namespace vkpp {
                       Semaphore& signal,
                       Fence& fence);
 
+        Queue& bind_sparse(const VkBindSparseInfo& bind_info);
+
         Queue& wait_idle();
 
         Queue& present(SwapChain& swap_chain,
@@ -17,7 +17,8 @@ namespace vkpp {
                 VkSamplerAddressMode wrap_u = VK_SAMPLER_ADDRESS_MODE_REPEAT,
                 VkSamplerAddressMode wrap_v = VK_SAMPLER_ADDRESS_MODE_REPEAT,
                 VkSamplerAddressMode wrap_w = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-                bool anisotropy = true, bool enable_compare_less_op = false);
+                bool anisotropy = true, bool enable_compare_less_op = false,
+                float max_lod = 0.0f); // only the first level by default.
 
         Sampler(Sampler&& sampler) noexcept;
         Sampler& operator=(Sampler&& sampler) noexcept;
@@ -107,3 +107,75 @@ project (name)
         links { "embree3", "glfw", "vulkan" }
         linkoptions  { "-fopenmp", "-lstdc++fs" }
         buildoptions { "-fopenmp" }
+
+-- Headless Embree-only reference renderer, for CPU-only nodes and CI.
+project (name.."-trace")
+    targetdir "bin"
+    kind "ConsoleApp"
+
+    defines "VKHR_HEADLESS"
+
+    includedirs "include"
+    files { "include/"..name.."/ray_tracer/**.hh",
+            "include/"..name.."/scene_graph/**.hh" }
+    files { "src/"..name.."/ray_tracer/**.cc",
+            "src/"..name.."/scene_graph/**.cc",
+            "src/"..name.."/ray_tracer.cc",
+            "src/"..name.."/scene_graph.cc",
+            "src/"..name.."/asset_cache.cc",
+            "src/"..name.."/mapped_file.cc",
+            "src/"..name.."/arg_parser.cc",
+            "src/"..name.."/image.cc" }
+    files   "src/trace.cc"
+
+    os.vpaths() -- Virtual paths.
+
+    includedirs "foreign/include"
+    includedirs "foreign/json/include"
+    includedirs "foreign/tinyobjloader"
+    files { "foreign/tinyobjloader/tiny_obj_loader.cc",
+            "foreign/tinyobjloader/tiny_obj_loader.h" }
+    includedirs "foreign/stb"
+    includedirs "foreign/glm"
+
+    filter { "system:windows", "action:gmake" }
+        includedirs { EMBREE.."/include" }
+        buildoptions { "-fopenmp" }
+        linkoptions { STATIC_LINK, "-fopenmp", "-lstdc++fs" }
+        links { EMBREE.."/lib/embree3" }
+    filter { "system:windows", "action:vs*" }
+        includedirs { EMBREE.."/include" }
+        buildoptions { "/openmp" }
+        links { EMBREE.."/lib/embree3.lib" }
+    filter "system:linux or bsd or solaris"
+        links { "embree3" }
+        linkoptions  { "-fopenmp", "-lstdc++fs" }
+        buildoptions { "-fopenmp" }
+
+-- Converts .hair styles to .hairz and checks they still round trip.
+project (name.."-hairz")
+    targetdir "bin"
+    kind "ConsoleApp"
+
+    includedirs "include"
+    files { "include/"..name.."/scene_graph/hair_style.hh",
+            "include/"..name.."/mapped_file.hh",
+            "include/"..name.."/arg_parser.hh",
+            "include/"..name.."/span.hh" }
+    files { "src/"..name.."/scene_graph/hair_style.cc",
+            "src/"..name.."/mapped_file.cc",
+            "src/"..name.."/arg_parser.cc" }
+    files   "src/hairz.cc"
+
+    os.vpaths() -- Virtual paths.
+
+    includedirs "foreign/glm"
+
+    filter { "system:windows", "action:gmake" }
+        buildoptions { "-fopenmp" }
+        linkoptions { STATIC_LINK, "-fopenmp", "-lstdc++fs" }
+    filter { "system:windows", "action:vs*" }
+        buildoptions { "/openmp" }
+    filter "system:linux or bsd or solaris"
+        linkoptions  { "-fopenmp", "-lstdc++fs" }
+        buildoptions { "-fopenmp" }
@@ -0,0 +1,149 @@
+#include <vkhr/arg_parser.hh>
+#include <vkhr/scene_graph/hair_style.hh>
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+// Converts a .hair style to the quantized .hairz format and loads it back
+// to check the round trip is still within the error of the quantization.
+// e.g. vkhr-hairz --output ponytail.hairz share/styles/ponytail.hair
+
+namespace vkhr {
+    std::vector<Argument> hairz_arguments {
+        { "output", Argument::Type::String,  Argument::make_string(""),     "" },
+        { "verify", Argument::Type::Boolean, Argument::make_boolean(true), "" },
+    };
+
+    template<typename T, typename Compare>
+    static bool compare_field(const char* name, const Span<T>& original, const Span<T>& decoded, Compare within_error) {
+        if (original.size() != decoded.size()) {
+            std::cerr << "Expected " << original.size() << " " << name << " but got " << decoded.size() << std::endl;
+            return false;
+        }
+
+        for (std::size_t i { 0 }; i < original.size(); ++i) {
+            if (!within_error(original[i], decoded[i])) {
+                std::cerr << "The " << name << " at " << i << " is beyond the quantization error" << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static bool compare_hair_styles(const HairStyle& original, const HairStyle& decoded) {
+        if (original.get_strand_count() != decoded.get_strand_count() ||
+            original.get_vertex_count() != decoded.get_vertex_count()) {
+            std::cerr << "Strand or vertex count doesn't match" << std::endl;
+            return false;
+        }
+
+        if (original.has_thickness()    != decoded.has_thickness()    ||
+            original.has_transparency() != decoded.has_transparency() ||
+            original.has_color()        != decoded.has_color()        ||
+            original.has_tangents()     != decoded.has_tangents()) {
+            std::cerr << "Fields in the header don't match" << std::endl;
+            return false;
+        }
+
+        if (original.has_segments() && !compare_field("segments", original.get_segments(), decoded.get_segments(),
+                                                      [](unsigned short a, unsigned short b) { return a == b; }))
+            return false;
+
+        const auto vertices = original.get_vertices();
+
+        if (vertices.empty()) return true; // Nothing left to compare.
+
+        glm::vec3 grid_min { vertices[0] }, grid_max { vertices[0] };
+        for (const auto& position : vertices) {
+            grid_min = glm::min(grid_min, position);
+            grid_max = glm::max(grid_max, position);
+        }
+
+        // Positions are rounded to the closest step of a 16-bit grid.
+        const glm::vec3 position_error { (grid_max - grid_min) / 65535.0f * 0.5f + 1e-5f };
+
+        if (!compare_field("vertices", vertices, decoded.get_vertices(), [&](const glm::vec3& a, const glm::vec3& b) {
+                return glm::all(glm::lessThanEqual(glm::abs(a - b), position_error));
+            })) return false;
+
+        // Thickness, transparency and color are all 8-bit unorms.
+        constexpr float unorm_error { 0.5f / 255.0f + 1e-5f };
+
+        if (original.has_thickness()) {
+            const auto thickness = original.get_thickness();
+            const float thickness_scale { *std::max_element(thickness.begin(), thickness.end()) };
+            if (!compare_field("thickness", thickness, decoded.get_thickness(), [&](float a, float b) {
+                    return std::abs(a - b) <= unorm_error * thickness_scale;
+                })) return false;
+        }
+
+        if (original.has_transparency() && !compare_field("transparency", original.get_transparency(), decoded.get_transparency(),
+                                                          [&](float a, float b) { return std::abs(a - b) <= unorm_error; }))
+            return false;
+
+        if (original.has_color() && !compare_field("color", original.get_color(), decoded.get_color(), [&](const glm::vec3& a, const glm::vec3& b) {
+                return glm::all(glm::lessThanEqual(glm::abs(a - b), glm::vec3 { unorm_error }));
+            })) return false;
+
+        // Octahedral tangents are stored normalized with 16-bits per axis.
+        if (original.has_tangents() && !compare_field("tangents", original.get_tangents(), decoded.get_tangents(), [](const glm::vec3& a, const glm::vec3& b) {
+                if (glm::length(a) == 0.0f) return true; // No direction to keep.
+                return glm::length(glm::normalize(a) - b) <= 1e-3f;
+            })) return false;
+
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    vkhr::ArgParser argp { vkhr::hairz_arguments };
+    auto style_file = argp.parse(argc, argv);
+
+    if (style_file.empty()) {
+        std::cerr << "Usage: vkhr-hairz [--output path] [--verify yes] style.hair" << std::endl;
+        return 1;
+    }
+
+    std::string output_file { argp["output"].value.string };
+    if (output_file.empty())
+        output_file = std::filesystem::path { style_file }.replace_extension(".hairz").string();
+
+    vkhr::HairStyle hair_style { style_file };
+
+    if (!hair_style) {
+        std::cerr << "Couldn't load the hair style " << style_file << std::endl;
+        return 1;
+    }
+
+    if (!hair_style.save_compressed(output_file)) {
+        std::cerr << "Couldn't save " << output_file << std::endl;
+        return 1;
+    }
+
+    auto original_size   = std::filesystem::file_size(style_file),
+         compressed_size = std::filesystem::file_size(output_file);
+
+    std::cout << style_file << " (" << original_size / (1024.0 * 1024.0) << " MiB) to "
+              << output_file << " (" << compressed_size / (1024.0 * 1024.0) << " MiB)" << std::endl;
+
+    if (!argp["verify"].value.boolean) return 0;
+
+    vkhr::HairStyle compressed_style { output_file };
+
+    if (!compressed_style) {
+        std::cerr << "Couldn't load back " << output_file << std::endl;
+        return 1;
+    }
+
+    if (!vkhr::compare_hair_styles(hair_style, compressed_style)) {
+        std::cerr << "Round trip failed for " << output_file << std::endl;
+        return 1;
+    }
+
+    std::cout << "Round trip is within the quantization error" << std::endl;
+
+    return 0;
+}
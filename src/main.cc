@@ -60,6 +60,8 @@ int main(int argc, char** argv) {
     window.show();
 
     if (argp["benchmark"].value.boolean == 1) {
+        vkhr::Benchmark::voxelization(scene_graph);
+        vkhr::Benchmark::ray_tracing(ray_tracer, scene_graph);
         vkhr::Benchmark::construct(rasterizer);
         rasterizer.run_benchmarks(scene_graph);
     }
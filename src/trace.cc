@@ -0,0 +1,198 @@
+#include <vkhr/arg_parser.hh>
+#include <vkhr/paths.hh>
+#include <vkhr/image.hh>
+
+#include <vkhr/scene_graph.hh>
+#include <vkhr/ray_tracer.hh>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Offline reference renderer: traces a scene with Embree for some samples
+// per pixel and saves it, without ever opening a window or touching Vulkan.
+// e.g. vkhr-trace --spp 256 --seed 1 --method ao --output ao.png bear.vkhr
+
+namespace vkhr {
+    std::vector<Argument> trace_arguments {
+        { "width",   Argument::Type::Integer,  Argument::make_integer(1280),           "" },
+        { "height",  Argument::Type::Integer,  Argument::make_integer(720),            "" },
+        { "spp",     Argument::Type::Integer,  Argument::make_integer(64),             "" },
+        { "error",   Argument::Type::Floating, Argument::make_floating(0.0f),          "" },
+        { "seed",    Argument::Type::Integer,  Argument::make_integer(0),              "" },
+        { "threads", Argument::Type::Integer,  Argument::make_integer(0),              "" },
+        { "method",  Argument::Type::String,   Argument::make_string("shaded"),        "" },
+        { "sampler", Argument::Type::String,   Argument::make_string("sobol"),         "" },
+        { "shadows", Argument::Type::Boolean,  Argument::make_boolean(true),           "" },
+        { "packets", Argument::Type::Boolean,  Argument::make_boolean(false),          "" },
+        { "quality", Argument::Type::String,   Argument::make_string("medium"),        "" },
+        { "curve",   Argument::Type::String,   Argument::make_string("flat"),          "" },
+        { "compact", Argument::Type::Boolean,  Argument::make_boolean(false),          "" },
+        { "robust",  Argument::Type::Boolean,  Argument::make_boolean(false),          "" },
+        { "output",  Argument::Type::String,   Argument::make_string("reference.png"), "" },
+    };
+
+    static bool parse_visualization_method(const std::string& name, Raytracer::VisualizationMethod& method) {
+        if (name == "shaded")
+            method = Raytracer::Shaded;
+        else if (name == "combined")
+            method = Raytracer::CombinedShadows;
+        else if (name == "shadows")
+            method = Raytracer::DirectShadows;
+        else if (name == "ao")
+            method = Raytracer::AmbientOcclusion;
+        else return false;
+        return true;
+    }
+
+    static bool parse_sampler_type(const std::string& name, Sampler::Type& sampler_type) {
+        if (name == "random")
+            sampler_type = Sampler::Type::Random;
+        else if (name == "cmj")
+            sampler_type = Sampler::Type::CorrelatedMultiJittered;
+        else if (name == "sobol")
+            sampler_type = Sampler::Type::Sobol;
+        else if (name == "bluenoise")
+            sampler_type = Sampler::Type::BlueNoise;
+        else return false;
+        return true;
+    }
+
+    static bool parse_build_quality(const std::string& name, RTCBuildQuality& build_quality) {
+        if (name == "low")
+            build_quality = RTC_BUILD_QUALITY_LOW;
+        else if (name == "medium")
+            build_quality = RTC_BUILD_QUALITY_MEDIUM;
+        else if (name == "high")
+            build_quality = RTC_BUILD_QUALITY_HIGH;
+        else return false;
+        return true;
+    }
+
+    static bool parse_curve(const std::string& name, Raytracer::BuildOptions::Curve& curve) {
+        if (name == "flat")
+            curve = Raytracer::BuildOptions::Curve::FlatLinear;
+        else if (name == "bspline")
+            curve = Raytracer::BuildOptions::Curve::FlatBSpline;
+        else if (name == "round")
+            curve = Raytracer::BuildOptions::Curve::RoundBSpline;
+        else return false;
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    vkhr::ArgParser argp { vkhr::trace_arguments };
+    auto scene_file = argp.parse(argc, argv);
+
+    if (scene_file.empty()) scene_file = SCENE("ponytail.vkhr");
+
+    vkhr::Raytracer::VisualizationMethod method;
+    if (!vkhr::parse_visualization_method(argp["method"].value.string, method)) {
+        std::cerr << "Unknown method '" << argp["method"].value.string
+                  << "', expected shaded, combined, shadows or ao." << std::endl;
+        return 1;
+    }
+
+    vkhr::Sampler::Type sampler_type;
+    if (!vkhr::parse_sampler_type(argp["sampler"].value.string, sampler_type)) {
+        std::cerr << "Unknown sampler '" << argp["sampler"].value.string
+                  << "', expected random, cmj, sobol or bluenoise." << std::endl;
+        return 1;
+    }
+
+    vkhr::Raytracer::BuildOptions build_options;
+
+    if (!vkhr::parse_build_quality(argp["quality"].value.string, build_options.quality)) {
+        std::cerr << "Unknown quality '" << argp["quality"].value.string
+                  << "', expected low, medium or high." << std::endl;
+        return 1;
+    }
+
+    if (!vkhr::parse_curve(argp["curve"].value.string, build_options.curve)) {
+        std::cerr << "Unknown curve '" << argp["curve"].value.string
+                  << "', expected flat, bspline or round." << std::endl;
+        return 1;
+    }
+
+    build_options.compact = argp["compact"].value.boolean;
+    build_options.robust  = argp["robust"].value.boolean;
+
+    vkhr::SceneGraph scene_graph { scene_file };
+
+    if (!scene_graph) {
+        std::cerr << "Couldn't load the scene " << scene_file << std::endl;
+        return 1;
+    }
+
+#ifdef _OPENMP
+    if (argp["threads"].value.integer > 0)
+        omp_set_num_threads(argp["threads"].value.integer);
+#endif
+
+    if (argp["threads"].value.integer > 0)
+        build_options.threads = argp["threads"].value.integer;
+
+    auto& camera { (scene_graph.get_camera()) };
+
+    int width  = argp["x"].value.integer,
+        height = argp["y"].value.integer;
+
+    camera.set_resolution(width, height);
+
+    vkhr::Raytracer ray_tracer { scene_graph, build_options };
+
+    for (const auto& hair_style : ray_tracer.get_hair_styles()) {
+        std::cout << "Built " << hair_style.get_segment_count() << " segments in "
+                  << hair_style.get_build_time() << " ms ("
+                  << hair_style.get_memory_usage() / (1024.0 * 1024.0) << " MiB)" << std::endl;
+    }
+
+    ray_tracer.set_sampler(sampler_type);
+    ray_tracer.set_seed(argp["seed"].value.integer);
+    ray_tracer.set_visualization_method(method);
+
+    if (!argp["shadows"].value.boolean)
+        ray_tracer.toggle_shadows();
+
+    if (argp["packets"].value.boolean)
+        ray_tracer.set_tracing_mode(vkhr::Raytracer::TracingMode::RayPackets);
+
+    // With --error, --spp is the upper limit on samples per pixel instead.
+    if (argp["error"].value.floating > 0.0f)
+        ray_tracer.set_target_error(argp["error"].value.floating);
+
+    const int samples_per_pixel { argp["spp"].value.integer };
+
+    std::size_t rays { 0 };
+    int samples { 0 };
+
+    auto start = std::chrono::steady_clock::now();
+    while (samples < samples_per_pixel && !ray_tracer.is_converged()) {
+        ray_tracer.draw(scene_graph);
+        rays += ray_tracer.get_ray_count();
+        ++samples;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    auto time = std::chrono::duration<double>(end - start).count();
+
+    std::cout << width << "x" << height << " at " << samples << " spp in "
+              << time << " s (" << rays / (time * 1e6) << " Mrays/s)" << std::endl;
+
+    if (argp["error"].value.floating > 0.0f) {
+        std::cout << ray_tracer.get_converged_pixel_count() << " of " << width * height
+                  << " pixels converged" << std::endl;
+    }
+
+    if (!ray_tracer.get_framebuffer().save(argp["output"].value.string)) {
+        std::cerr << "Couldn't save " << argp["output"].value.string << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,379 @@
+#include <vkhr/asset_cache.hh>
+
+#include <vkhr/mapped_file.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#ifdef WINDOWS
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace vkhr {
+    AssetCache::AssetCache(const std::string& cache_directory)
+                          : directory { cache_directory } {
+        if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+            directory += '/';
+    }
+
+    static std::string to_hex(std::uint64_t value) {
+        char hex_string[17];
+        std::snprintf(hex_string, sizeof(hex_string), "%016llx", static_cast<unsigned long long>(value));
+        return hex_string;
+    }
+
+    std::string AssetCache::get_key(const std::string& asset_path, const std::string& parameters) const {
+        std::uint64_t key;
+
+        if (!hash_asset(asset_path, key))
+            return ""; // Nothing to key on.
+
+        key = hash(parameters.data(), parameters.size(), key);
+        key = hash(reinterpret_cast<const char*>(&FormatVersion), sizeof(FormatVersion), key);
+
+        return to_hex(key);
+    }
+
+    bool AssetCache::hash_asset(const std::string& asset_path, std::uint64_t& content_hash) const {
+        std::error_code error;
+
+        auto size = std::filesystem::file_size(asset_path, error);
+        if (error) return false;
+        auto modified = std::filesystem::last_write_time(asset_path, error).time_since_epoch().count();
+        if (error) return false;
+
+        // Named after where the asset is, since that's what we know about it.
+        auto absolute_path = std::filesystem::absolute(asset_path, error).string();
+        auto stamp_key = to_hex(hash(absolute_path.data(), absolute_path.size()));
+
+        AssetStamp stamp;
+
+        if (std::ifstream stamp_file { get_path(stamp_key, ".stamp"), std::ios::binary };
+            stamp_file.read(reinterpret_cast<char*>(&stamp), sizeof(AssetStamp)) &&
+            std::strncmp(stamp.signature, "STMP", 4) == 0 &&
+            stamp.size == size && stamp.modified == modified) {
+            content_hash = stamp.content_hash;
+            return true;
+        }
+
+        MappedFile asset { asset_path };
+
+        if (!asset) return false;
+
+        stamp = AssetStamp {
+            { 'S', 'T', 'M', 'P' },
+            static_cast<std::uint64_t>(size),
+            static_cast<std::int64_t>(modified),
+            hash(asset.get_data(), asset.get_size())
+        };
+
+        content_hash = stamp.content_hash;
+
+        if (!create_directory())
+            return true; // Hashed again next time.
+
+        auto temporary_path = get_temporary_path(stamp_key, ".stamp");
+
+        bool written;
+
+        {
+            std::ofstream file { temporary_path, std::ios::binary };
+            written = static_cast<bool>(file.write(reinterpret_cast<const char*>(&stamp), sizeof(AssetStamp)));
+        }
+
+        if (written) replace(temporary_path, get_path(stamp_key, ".stamp"));
+        else std::filesystem::remove(temporary_path, error);
+
+        return true;
+    }
+
+    std::string AssetCache::get_path(const std::string& key, const std::string& extension) const {
+        return directory + key + extension;
+    }
+
+    std::string AssetCache::get_temporary_path(const std::string& key, const std::string& extension) const {
+        static std::atomic<unsigned> temporary_count { 0 };
+    #ifdef WINDOWS
+        auto process_id = _getpid();
+    #else
+        auto process_id = getpid();
+    #endif
+        return get_path(key, extension) + "." + std::to_string(process_id)
+                                        + "." + std::to_string(temporary_count++) + ".tmp";
+    }
+
+    bool AssetCache::replace(const std::string& temporary_path, const std::string& path) const {
+        std::error_code error;
+        std::filesystem::rename(temporary_path, path, error);
+        if (error) std::filesystem::remove(temporary_path, error);
+        return std::filesystem::is_regular_file(path, error);
+    }
+
+    bool AssetCache::contains(const std::string& key, const std::string& extension) const {
+        std::error_code error;
+        return !key.empty() && std::filesystem::is_regular_file(get_path(key, extension), error);
+    }
+
+    bool AssetCache::load(const std::string& key, HairStyle& hair_style) const {
+        if (!contains(key, ".hair"))
+            return false;
+
+        // Mapped, so the vertex data is only paged in when it's uploaded.
+        if (!hair_style.map(get_path(key, ".hair")))
+            return false;
+
+        hair_style.set_cache_key(key);
+
+        return true;
+    }
+
+    bool AssetCache::save(const std::string& key, const HairStyle& hair_style) const {
+        if (key.empty() || !create_directory())
+            return false;
+
+        // Write to a temporary first, so a crash can't leave half an entry.
+        auto temporary_path = get_temporary_path(key, ".hair");
+
+        if (!hair_style.save(temporary_path)) {
+            std::error_code error;
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+
+        return replace(temporary_path, get_path(key, ".hair"));
+    }
+
+    bool AssetCache::load(const std::string& key, HairStyle::BrickVolume& volume) const {
+        if (!contains(key, ".bricks"))
+            return false;
+
+        std::ifstream file { get_path(key, ".bricks"), std::ios::binary };
+
+        VolumeHeader header;
+
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(VolumeHeader)))
+            return false;
+
+        if (std::strncmp(header.signature, "BRIK", 4) != 0)
+            return false;
+
+        constexpr int brick_size { HairStyle::BrickVolume::BrickSize };
+
+        volume.resolution = glm::vec3 { header.width, header.height, header.depth };
+        volume.bounds = header.bounds;
+        volume.brick_grid = (glm::ivec3 { volume.resolution } + brick_size - 1) / brick_size;
+
+        std::size_t table_size { static_cast<std::size_t>(volume.brick_grid.x) * volume.brick_grid.y * volume.brick_grid.z };
+        std::size_t mask_size { static_cast<std::size_t>(header.brick_count) * HairStyle::BrickVolume::MaskWords };
+
+        volume.brick_table.resize(table_size);
+        volume.occupancy.resize(mask_size);
+        volume.densities.resize(header.voxel_count);
+        volume.tangents.resize(header.voxel_count);
+
+        if (!file.read(reinterpret_cast<char*>(volume.brick_table.data()), table_size * sizeof(volume.brick_table[0])) ||
+            !file.read(reinterpret_cast<char*>(volume.occupancy.data()), mask_size * sizeof(volume.occupancy[0])) ||
+            !file.read(reinterpret_cast<char*>(volume.densities.data()), header.voxel_count * sizeof(volume.densities[0])) ||
+            !file.read(reinterpret_cast<char*>(volume.tangents.data()),  header.voxel_count * sizeof(volume.tangents[0])))
+            return false;
+
+        for (auto brick : volume.brick_table) // Don't trust the file!
+            if (brick != HairStyle::BrickVolume::EmptyBrick && brick >= header.brick_count)
+                return false;
+
+        return volume.generate_voxel_offsets() == header.voxel_count;
+    }
+
+    bool AssetCache::save(const std::string& key, const HairStyle::BrickVolume& volume) const {
+        if (key.empty() || !create_directory())
+            return false;
+
+        VolumeHeader header {
+            { 'B', 'R', 'I', 'K' },
+            static_cast<unsigned>(volume.resolution.x),
+            static_cast<unsigned>(volume.resolution.y),
+            static_cast<unsigned>(volume.resolution.z),
+            volume.bounds,
+            static_cast<unsigned>(volume.get_brick_count()),
+            static_cast<unsigned>(volume.densities.size())
+        };
+
+        auto temporary_path = get_temporary_path(key, ".bricks");
+
+        bool written;
+
+        {
+            std::ofstream file { temporary_path, std::ios::binary };
+
+            written = file.write(reinterpret_cast<const char*>(&header), sizeof(VolumeHeader)) &&
+                      file.write(reinterpret_cast<const char*>(volume.brick_table.data()), volume.brick_table.size() * sizeof(volume.brick_table[0])) &&
+                      file.write(reinterpret_cast<const char*>(volume.occupancy.data()), volume.occupancy.size() * sizeof(volume.occupancy[0])) &&
+                      file.write(reinterpret_cast<const char*>(volume.densities.data()), volume.densities.size() * sizeof(volume.densities[0])) &&
+                      file.write(reinterpret_cast<const char*>(volume.tangents.data()),  volume.tangents.size()  * sizeof(volume.tangents[0]));
+        }
+
+        if (!written) {
+            std::error_code error;
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+
+        return replace(temporary_path, get_path(key, ".bricks"));
+    }
+
+    bool AssetCache::load(const std::string& key, HairStyle::GuideStrands& guide_strands) const {
+        if (!contains(key, ".guides"))
+            return false;
+
+        std::ifstream file { get_path(key, ".guides"), std::ios::binary };
+
+        GuideHeader header;
+
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(GuideHeader)))
+            return false;
+
+        if (std::strncmp(header.signature, "GUID", 4) != 0 || header.vertices_per_guide < 2)
+            return false;
+
+        std::size_t guide_vertex_count { static_cast<std::size_t>(header.guide_count) * header.vertices_per_guide };
+
+        guide_strands.vertices_per_guide = header.vertices_per_guide;
+        guide_strands.vertices.resize(guide_vertex_count);
+        guide_strands.guides.resize(header.strand_count);
+        guide_strands.weights.resize(header.strand_count);
+        guide_strands.offsets.resize(header.strand_count);
+
+        if (!file.read(reinterpret_cast<char*>(guide_strands.vertices.data()), guide_vertex_count  * sizeof(guide_strands.vertices[0])) ||
+            !file.read(reinterpret_cast<char*>(guide_strands.guides.data()),   header.strand_count * sizeof(guide_strands.guides[0]))   ||
+            !file.read(reinterpret_cast<char*>(guide_strands.weights.data()),  header.strand_count * sizeof(guide_strands.weights[0]))  ||
+            !file.read(reinterpret_cast<char*>(guide_strands.offsets.data()),  header.strand_count * sizeof(guide_strands.offsets[0])))
+            return false;
+
+        for (const auto& guides : guide_strands.guides) // Don't trust the file!
+            if (glm::compMax(guides) >= header.guide_count)
+                return false;
+
+        return true;
+    }
+
+    bool AssetCache::save(const std::string& key, const HairStyle::GuideStrands& guide_strands) const {
+        if (key.empty() || !create_directory())
+            return false;
+
+        GuideHeader header {
+            { 'G', 'U', 'I', 'D' },
+            guide_strands.vertices_per_guide,
+            guide_strands.get_guide_count(),
+            static_cast<unsigned>(guide_strands.guides.size())
+        };
+
+        auto temporary_path = get_temporary_path(key, ".guides");
+
+        bool written;
+
+        {
+            std::ofstream file { temporary_path, std::ios::binary };
+
+            written = file.write(reinterpret_cast<const char*>(&header), sizeof(GuideHeader)) &&
+                      file.write(reinterpret_cast<const char*>(guide_strands.vertices.data()), guide_strands.vertices.size() * sizeof(guide_strands.vertices[0])) &&
+                      file.write(reinterpret_cast<const char*>(guide_strands.guides.data()),   guide_strands.guides.size()   * sizeof(guide_strands.guides[0]))   &&
+                      file.write(reinterpret_cast<const char*>(guide_strands.weights.data()),  guide_strands.weights.size()  * sizeof(guide_strands.weights[0]))  &&
+                      file.write(reinterpret_cast<const char*>(guide_strands.offsets.data()),  guide_strands.offsets.size()  * sizeof(guide_strands.offsets[0]));
+        }
+
+        if (!written) {
+            std::error_code error;
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+
+        return replace(temporary_path, get_path(key, ".guides"));
+    }
+
+    bool AssetCache::load(const std::string& key, HairStyle::SimplifiedStrands& simplified_strands) const {
+        if (!contains(key, ".simplified"))
+            return false;
+
+        std::ifstream file { get_path(key, ".simplified"), std::ios::binary };
+
+        SimplifiedHeader header;
+
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(SimplifiedHeader)))
+            return false;
+
+        if (std::strncmp(header.signature, "SIMP", 4) != 0)
+            return false;
+
+        simplified_strands.max_error = header.max_error;
+        simplified_strands.indices.resize(static_cast<std::size_t>(header.segment_count) * 2);
+        simplified_strands.segment_offsets.resize(static_cast<std::size_t>(header.strand_count) + 1);
+
+        if (!file.read(reinterpret_cast<char*>(simplified_strands.indices.data()),         simplified_strands.indices.size()         * sizeof(simplified_strands.indices[0])) ||
+            !file.read(reinterpret_cast<char*>(simplified_strands.segment_offsets.data()), simplified_strands.segment_offsets.size() * sizeof(simplified_strands.segment_offsets[0])))
+            return false;
+
+        // Don't trust the file! The draws use these to size themselves.
+        if (!std::is_sorted(simplified_strands.segment_offsets.begin(), simplified_strands.segment_offsets.end()) ||
+            simplified_strands.segment_offsets.front() != 0 || simplified_strands.segment_offsets.back() != header.segment_count)
+            return false;
+
+        return true;
+    }
+
+    bool AssetCache::save(const std::string& key, const HairStyle::SimplifiedStrands& simplified_strands) const {
+        if (key.empty() || simplified_strands.segment_offsets.empty() || !create_directory())
+            return false;
+
+        SimplifiedHeader header {
+            { 'S', 'I', 'M', 'P' },
+            simplified_strands.max_error,
+            static_cast<unsigned>(simplified_strands.segment_offsets.size() - 1),
+            static_cast<unsigned>(simplified_strands.indices.size() / 2)
+        };
+
+        auto temporary_path = get_temporary_path(key, ".simplified");
+
+        bool written;
+
+        {
+            std::ofstream file { temporary_path, std::ios::binary };
+
+            written = file.write(reinterpret_cast<const char*>(&header), sizeof(SimplifiedHeader)) &&
+                      file.write(reinterpret_cast<const char*>(simplified_strands.indices.data()),         simplified_strands.indices.size()         * sizeof(simplified_strands.indices[0])) &&
+                      file.write(reinterpret_cast<const char*>(simplified_strands.segment_offsets.data()), simplified_strands.segment_offsets.size() * sizeof(simplified_strands.segment_offsets[0]));
+        }
+
+        if (!written) {
+            std::error_code error;
+            std::filesystem::remove(temporary_path, error);
+            return false;
+        }
+
+        return replace(temporary_path, get_path(key, ".simplified"));
+    }
+
+    const std::string& AssetCache::get_directory() const {
+        return directory;
+    }
+
+    std::uint64_t AssetCache::hash(const char* data, std::size_t size, std::uint64_t hash) {
+        for (std::size_t i { 0 }; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    bool AssetCache::create_directory() const {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        return std::filesystem::is_directory(directory, error);
+    }
+}
@@ -9,6 +9,7 @@
 #include <ctime>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
 
 namespace vkhr {
     Image::Image(const unsigned width, const unsigned height)
@@ -208,6 +209,21 @@ namespace vkhr {
         }
     }
 
+    void Image::copy(const std::vector<glm::dvec3>& buffer, const std::vector<std::uint32_t>& samples) {
+        #pragma omp parallel for schedule(dynamic)
+        for (int j = 0; j < get_height(); ++j)
+        for (int i = 0; i < get_width();  ++i) {
+            std::size_t pixel { i + j * get_width() };
+            double pixel_samples = std::max(samples[pixel], 1u);
+            set_pixel(get_width() - i - 1, j, {
+                static_cast<unsigned char>(glm::clamp(buffer[pixel].r / pixel_samples, 0.0, 1.0) * 255.0),
+                static_cast<unsigned char>(glm::clamp(buffer[pixel].g / pixel_samples, 0.0, 1.0) * 255.0),
+                static_cast<unsigned char>(glm::clamp(buffer[pixel].b / pixel_samples, 0.0, 1.0) * 255.0),
+                255
+            });
+        }
+    }
+
     void Image::resize(const unsigned width, const unsigned height) {
         if (width == this->width && height == this->height)
             return; // We're done here folks!
@@ -0,0 +1,137 @@
+#include <vkhr/mapped_file.hh>
+
+#include <utility>
+
+#ifdef WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vkhr {
+    MappedFile::MappedFile(const std::string& file_path) {
+        open(file_path);
+    }
+
+    MappedFile::~MappedFile() noexcept {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& mapped_file) noexcept {
+        swap(*this, mapped_file);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& mapped_file) noexcept {
+        swap(*this, mapped_file);
+        return *this;
+    }
+
+    void swap(MappedFile& lhs, MappedFile& rhs) {
+        using std::swap;
+        swap(lhs.data, rhs.data);
+        swap(lhs.size, rhs.size);
+    #ifdef WINDOWS
+        swap(lhs.file_handle,    rhs.file_handle);
+        swap(lhs.mapping_handle, rhs.mapping_handle);
+    #endif
+    }
+
+#ifdef WINDOWS
+    bool MappedFile::open(const std::string& file_path) {
+        close(); // Any previous mapping.
+
+        HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            CloseHandle(file);
+            return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        file_handle    = file;
+        mapping_handle = mapping;
+
+        data = static_cast<const char*>(view);
+        size = static_cast<std::size_t>(file_size.QuadPart);
+
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (data != nullptr) UnmapViewOfFile(data);
+        if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+        if (file_handle != nullptr) CloseHandle(file_handle);
+        mapping_handle = nullptr;
+        file_handle = nullptr;
+        data = nullptr;
+        size = 0;
+    }
+#else
+    bool MappedFile::open(const std::string& file_path) {
+        close(); // Any previous mapping.
+
+        int file = ::open(file_path.c_str(), O_RDONLY);
+        if (file == -1)
+            return false;
+
+        struct stat file_status;
+        if (fstat(file, &file_status) == -1 || file_status.st_size == 0) {
+            ::close(file);
+            return false;
+        }
+
+        void* view = mmap(nullptr, file_status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+        ::close(file); // The mapping keeps its own reference to the file.
+
+        if (view == MAP_FAILED)
+            return false;
+
+        // We read the arrays front-to-back, so tell the kernel to read-ahead.
+        madvise(view, file_status.st_size, MADV_SEQUENTIAL);
+
+        data = static_cast<const char*>(view);
+        size = static_cast<std::size_t>(file_status.st_size);
+
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (data != nullptr) munmap(const_cast<char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+#endif
+
+    MappedFile::operator bool() const {
+        return data != nullptr;
+    }
+
+    const char* MappedFile::get_data() const {
+        return data;
+    }
+
+    std::size_t MappedFile::get_size() const {
+        return size;
+    }
+}
@@ -7,6 +7,7 @@
 #include <iomanip>
 #include <cstdio>
 #include <cctype>
+#include <algorithm>
 
 namespace vkhr {
     Rasterizer::Rasterizer(Window& window, const SceneGraph& scene_graph) {
@@ -157,6 +158,8 @@ namespace vkhr {
             shadow_maps.emplace_back(1024, *this, light_source);
 
         build_pipelines();
+
+        interpolate();
     }
 
     void Rasterizer::update(const SceneGraph& scene_graph) {
@@ -165,6 +168,12 @@ namespace vkhr {
         level_of_detail = glm::smoothstep(imgui.parameters.lod_magnified_distance,
                                           imgui.parameters.lod_minified_distance,
                                           scene_graph.get_camera().get_distance());
+
+        // Simplify the strands as long as the error stays below a pixel.
+        auto& scene_camera = scene_graph.get_camera();
+        auto pixel_size = scene_camera.get_pixel_size(scene_camera.get_distance());
+        for (auto& hair_style : hair_styles)
+            hair_style.second.simplify(pixel_size);
         params[frame].update(imgui.parameters); // Rendering parameter.
     }
 
@@ -209,6 +218,26 @@ namespace vkhr {
         frame = fetch_next_frame();
     }
 
+    bool Rasterizer::update_hair_style(const HairStyle& hair_style) {
+        auto vulkan_hair_style = hair_styles.find(&hair_style);
+
+        if (vulkan_hair_style == hair_styles.end())
+            return false;
+
+        device.wait_idle(); // The frames in flight may still be drawing it.
+
+        vulkan_hair_style->second.update(hair_style, *this);
+
+        // It was re-created if the strands were added or removed.
+        if (vulkan_hair_style->second.has_guide_strands()) {
+            if (hair_guide_pipeline.compute_pipeline.get_handle() == VK_NULL_HANDLE)
+                vulkan::HairStyle::guide_pipeline(hair_guide_pipeline, *this);
+            interpolate();
+        }
+
+        return true;
+    }
+
     std::uint32_t Rasterizer::fetch_next_frame() {
         return (frame + 1) % swap_chain.size();
     }
@@ -229,6 +258,30 @@ namespace vkhr {
         vk::DebugMarker::close(command_buffers[frame], "Voxelize Strands", query_pools[frame]);
     }
 
+    void Rasterizer::interpolate() {
+        if (hair_guide_pipeline.compute_pipeline.get_handle() == VK_NULL_HANDLE)
+            return; // There are no guide strands in this scene.
+
+        // One at a time, since every style writes the same descriptor set.
+        for (auto& hair_style : hair_styles) {
+            if (!hair_style.second.has_guide_strands())
+                continue;
+
+            auto command_buffer = command_pool.allocate_and_begin();
+
+            command_buffer.bind_pipeline(hair_guide_pipeline);
+
+            hair_style.second.interpolate(hair_guide_pipeline,
+                                          hair_guide_pipeline.descriptor_sets[0],
+                                          command_buffer);
+
+            command_buffer.end();
+
+            command_pool.get_queue().submit(command_buffer)
+                                    .wait_idle();
+        }
+    }
+
     void Rasterizer::draw_color(const SceneGraph& scene_graph, vk::CommandBuffer& command_buffer) {
         vk::DebugMarker::begin(command_buffers[frame], "Color Pass");
 
@@ -386,6 +439,13 @@ namespace vkhr {
         vulkan::HairStyle::depth_pipeline(hair_depth_pipeline, *this);
         vulkan::Model::depth_pipeline(mesh_depth_pipeline, *this);
         vulkan::HairStyle::voxel_pipeline(hair_voxel_pipeline, *this);
+
+        // The interpolation is only needed (and built) if there are guides.
+        if (std::any_of(hair_styles.begin(), hair_styles.end(), [](const auto& hair_style) {
+            return hair_style.second.has_guide_strands();
+        })) vulkan::HairStyle::guide_pipeline(hair_guide_pipeline, *this);
+        else hair_guide_pipeline = {};
+
         vulkan::Volume::build_pipeline(strand_dvr_pipeline, *this);
         vulkan::LinkedList::build_pipeline(ppll_blend_pipeline, *this);
         vulkan::HairStyle::build_pipeline(hair_style_pipeline, *this);
@@ -557,6 +617,10 @@ namespace vkhr {
         if (recompile_pipeline_shaders(hair_depth_pipeline)) vulkan::HairStyle::depth_pipeline(hair_depth_pipeline, *this);
         if (recompile_pipeline_shaders(mesh_depth_pipeline)) vulkan::Model::depth_pipeline(mesh_depth_pipeline, *this);
         if (recompile_pipeline_shaders(hair_voxel_pipeline)) vulkan::HairStyle::voxel_pipeline(hair_voxel_pipeline, *this);
+        if (recompile_pipeline_shaders(hair_guide_pipeline)) {
+            vulkan::HairStyle::guide_pipeline(hair_guide_pipeline, *this);
+            interpolate(); // Since they're only interpolated when loaded.
+        }
 
         if (recompile_pipeline_shaders(strand_dvr_pipeline)) vulkan::Volume::build_pipeline(strand_dvr_pipeline,     *this);
         if (recompile_pipeline_shaders(ppll_blend_pipeline)) vulkan::LinkedList::build_pipeline(ppll_blend_pipeline, *this);
@@ -577,6 +641,7 @@ namespace vkhr {
         hair_depth_pipeline = {};
         mesh_depth_pipeline = {};
         hair_voxel_pipeline = {};
+        hair_guide_pipeline = {};
         strand_dvr_pipeline = {};
         ppll_blend_pipeline = {};
         hair_style_pipeline = {};
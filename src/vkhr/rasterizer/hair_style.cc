@@ -1,12 +1,17 @@
 #include <vkhr/rasterizer/hair_style.hh>
 
 #include <vkhr/rasterizer.hh>
+#include <vkhr/asset_cache.hh>
 
 #include <vkhr/scene_graph/camera.hh>
 #include <vkhr/scene_graph/light_source.hh>
 
 #include <vkpp/debug_marker.hh>
 
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
 namespace vkhr {
     namespace vulkan {
         HairStyle::HairStyle(const vkhr::HairStyle& hair_style,
@@ -16,22 +21,32 @@ namespace vkhr {
 
         void HairStyle::load(const vkhr::HairStyle& hair_style,
                              vkhr::Rasterizer& vulkan_renderer) {
-            vertices = vk::VertexBuffer {
-                vulkan_renderer.device,
-                vulkan_renderer.command_pool,
-                hair_style.get_vertices()
-            };
+            pointer = &hair_style;
+
+            // These are written by interpolate() instead, if there are guides.
+            if (load_guide_strands(hair_style, vulkan_renderer)) {
+                vertices = vk::VertexBuffer { vulkan_renderer.device, hair_style.get_vertex_count(), sizeof(glm::vec3) };
+                tangents = vk::VertexBuffer { vulkan_renderer.device, hair_style.get_vertex_count(), sizeof(glm::vec3) };
+            } else {
+                vertices = vk::VertexBuffer {
+                    vulkan_renderer.device,
+                    vulkan_renderer.command_pool,
+                    hair_style.get_vertices().data(),
+                    hair_style.get_vertices().size()
+                };
+
+                tangents = vk::VertexBuffer {
+                    vulkan_renderer.device,
+                    vulkan_renderer.command_pool,
+                    hair_style.get_tangents().data(),
+                    hair_style.get_tangents().size()
+                };
+            }
 
             vk::DebugMarker::object_name(vulkan_renderer.device, vertices, VK_OBJECT_TYPE_BUFFER, "Hair Position Vertex Buffer", id);
             vk::DebugMarker::object_name(vulkan_renderer.device, vertices.get_device_memory(), VK_OBJECT_TYPE_DEVICE_MEMORY,
                                          "Hair Position Device Memory", id);
 
-            tangents = vk::VertexBuffer {
-                vulkan_renderer.device,
-                vulkan_renderer.command_pool,
-                hair_style.get_tangents()
-            };
-
             vk::DebugMarker::object_name(vulkan_renderer.device, tangents, VK_OBJECT_TYPE_BUFFER, "Hair Tangent Vertex Buffer", id);
             vk::DebugMarker::object_name(vulkan_renderer.device, tangents.get_device_memory(), VK_OBJECT_TYPE_DEVICE_MEMORY,
                                          "Hair Tangent Device Memory", id);
@@ -39,7 +54,8 @@ namespace vkhr {
             thickness = vk::VertexBuffer {
                 vulkan_renderer.device,
                 vulkan_renderer.command_pool,
-                hair_style.get_thickness()
+                hair_style.get_thickness().data(),
+                hair_style.get_thickness().size()
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, thickness, VK_OBJECT_TYPE_BUFFER, "Hair Thickness Vertex Buffer", id);
@@ -49,13 +65,36 @@ namespace vkhr {
             segments = vk::IndexBuffer {
                 vulkan_renderer.device,
                 vulkan_renderer.command_pool,
-                hair_style.get_indices()
+                hair_style.get_indices().data(),
+                hair_style.get_indices().size()
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, segments, VK_OBJECT_TYPE_BUFFER, "Hair Index Buffer", id);
             vk::DebugMarker::object_name(vulkan_renderer.device, segments.get_device_memory(), VK_OBJECT_TYPE_DEVICE_MEMORY,
                                          "Hair Index Device Memory", id);
 
+            simplified_geometry.clear();
+            simplified_level = -1;
+
+            for (const auto& simplified_strands : hair_style.get_simplified_lods()) {
+                SimplifiedGeometry simplified;
+
+                simplified.pointer = &simplified_strands;
+
+                simplified.segments = vk::IndexBuffer {
+                    vulkan_renderer.device,
+                    vulkan_renderer.command_pool,
+                    simplified_strands.indices.data(),
+                    simplified_strands.indices.size()
+                };
+
+                vk::DebugMarker::object_name(vulkan_renderer.device, simplified.segments, VK_OBJECT_TYPE_BUFFER, "Simplified Hair Index Buffer", id);
+
+                simplified.segment_count = simplified_strands.get_segment_count(static_cast<unsigned>(hair_style.get_strand_count()));
+
+                simplified_geometry.push_back(std::move(simplified));
+            }
+
             parameters.hair_shininess = 80.0f; // Using Kajiya-Kay.
             parameters.strand_radius = hair_style.get_default_thickness();
             parameters.hair_opacity = hair_style.get_default_transparency();
@@ -65,6 +104,8 @@ namespace vkhr {
             parameters.volume_resolution = glm::vec3 { 256,256,256 };
             parameters.volume_bounds = hair_style.get_bounding_box();
 
+            level_of_detail = hair_style.get_level_of_detail(parameters.strand_ratio);
+
             parameter_buffer = vk::UniformBuffer {
                 vulkan_renderer.device,
                 parameters
@@ -72,16 +113,285 @@ namespace vkhr {
 
             vk::DebugMarker::object_name(vulkan_renderer.device, parameter_buffer, VK_OBJECT_TYPE_BUFFER, "Hair Parameters Buffer", id);
 
-            auto strand_volume = hair_style.voxelize_segments(256, 256, 256);
+            vkhr::AssetCache asset_cache;
+
+            // The cache key is empty if the style itself wasn't cached.
+            std::string volume_key = hair_style.get_cache_key();
+            if (!volume_key.empty()) volume_key += "-segments-sampled-256";
+
+            vkhr::HairStyle::BrickVolume strand_bricks;
+
+            if (!asset_cache.load(volume_key, strand_bricks)) {
+                strand_bricks = hair_style.voxelize_bricks(256, 256, 256, vkhr::HairStyle::Voxelization::Sampled);
+                strand_bricks.normalize();
+                asset_cache.save(volume_key, strand_bricks);
+            }
+
+            auto strand_volume = strand_bricks.to_dense();
+
+            upload_volume(strand_volume, vk::DeviceImage::Residency::Sparse, vulkan_renderer);
 
-            strand_volume.normalize();
+            volume = Volume {
+                *this,
+                vulkan_renderer
+            };
+
+            ++id;
+        }
+
+        void HairStyle::update(const vkhr::HairStyle& hair_style,
+                               vkhr::Rasterizer& vulkan_renderer) {
+            // Strands were added or removed, so there is nothing to keep.
+            if (hair_style.get_vertex_count() != vertices.count()) {
+                dynamic_volume = vkhr::HairStyle::DynamicVolume {  };
+                load(hair_style, vulkan_renderer);
+                return;
+            }
+
+            const auto& dirty_strands = hair_style.get_dirty_strands();
+
+            if (dirty_strands.empty())
+                return;
+
+            const glm::ivec3 resolution { parameters.volume_resolution };
+
+            std::vector<std::size_t> changed_bricks;
+
+            if (dynamic_volume.volume.densities.empty()) {
+                dynamic_volume = hair_style.voxelize_dynamic(resolution.x, resolution.y, resolution.z,
+                                                             vkhr::HairStyle::Voxelization::Sampled);
+                dynamic_volume.normalize();
+
+                // Dense, since the strands can now move into blocks that a
+                // sparse image wouldn't have given any memory to at load.
+                auto strand_volume = dynamic_volume.volume;
+                upload_volume(strand_volume, vk::DeviceImage::Residency::Full, vulkan_renderer);
+            } else {
+                hair_style.revoxelize(dynamic_volume);
+
+                constexpr int brick_size { vkhr::HairStyle::BrickVolume::BrickSize };
+                const glm::ivec3 brick_grid { (resolution + brick_size - 1) / brick_size };
+
+                for (auto voxel : dynamic_volume.changed_voxels) {
+                    glm::ivec3 brick {
+                        voxel % resolution.x / brick_size,
+                        voxel / resolution.x % resolution.y / brick_size,
+                        voxel / (resolution.x * resolution.y) / brick_size
+                    };
+
+                    changed_bricks.push_back(brick.x + brick.y * brick_grid.x + brick.z * brick_grid.x * brick_grid.y);
+                }
+
+                std::sort(changed_bricks.begin(), changed_bricks.end());
+                changed_bricks.erase(std::unique(changed_bricks.begin(), changed_bricks.end()),
+                                     changed_bricks.end());
+            }
+
+            // Each brick is copied from a tightly packed part of the buffer.
+            std::vector<unsigned char> density_data;
+            std::vector<glm::i8vec4>   tangent_data;
+            std::vector<VkBufferImageCopy> density_copies, tangent_copies;
+
+            for (auto brick : changed_bricks) {
+                constexpr int brick_size { vkhr::HairStyle::BrickVolume::BrickSize };
+                const glm::ivec3 brick_grid { (resolution + brick_size - 1) / brick_size };
+
+                glm::ivec3 offset {
+                    static_cast<int>(brick % brick_grid.x) * brick_size,
+                    static_cast<int>(brick / brick_grid.x % brick_grid.y) * brick_size,
+                    static_cast<int>(brick / (brick_grid.x * brick_grid.y)) * brick_size
+                };
+
+                glm::ivec3 extent { glm::min(glm::ivec3 { brick_size }, resolution - offset) };
+
+                VkBufferImageCopy copy {  };
+
+                copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                copy.imageSubresource.mipLevel = 0;
+                copy.imageSubresource.layerCount = 1;
+
+                copy.imageOffset = { offset.x, offset.y, offset.z };
+                copy.imageExtent = { static_cast<std::uint32_t>(extent.x),
+                                     static_cast<std::uint32_t>(extent.y),
+                                     static_cast<std::uint32_t>(extent.z) };
+
+                copy.bufferOffset = density_data.size();
+                density_copies.push_back(copy);
+                copy.bufferOffset = tangent_data.size() * sizeof(tangent_data[0]);
+                tangent_copies.push_back(copy);
+
+                for (int z = 0; z < extent.z; ++z)
+                for (int y = 0; y < extent.y; ++y) {
+                    std::size_t row { offset.x + (offset.y + y) * static_cast<std::size_t>(resolution.x) +
+                                                 (offset.z + z) * static_cast<std::size_t>(resolution.x) * resolution.y };
+                    density_data.insert(density_data.end(), dynamic_volume.volume.densities.begin() + row,
+                                                            dynamic_volume.volume.densities.begin() + row + extent.x);
+                    tangent_data.insert(tangent_data.end(), dynamic_volume.volume.tangents.begin() + row,
+                                                            dynamic_volume.volume.tangents.begin() + row + extent.x);
+                }
+
+                // Buffer to image copies need their offsets to be 4-byte aligned.
+                density_data.resize((density_data.size() + 3) & ~std::size_t { 3 }, 0);
+            }
+
+            // Strands have the same place in the vertex and tangent buffers.
+            const auto& strand_offsets = hair_style.get_strand_offsets();
+
+            std::vector<glm::vec3> strand_vertices, strand_tangents;
+            std::vector<VkBufferCopy> strand_copies;
+
+            for (auto strand : dirty_strands) {
+                if (has_guide_strands())
+                    break; // These draw the strands interpolated from guides.
+
+                const std::size_t begin { strand_offsets[strand + 0] },
+                                  end   { strand_offsets[strand + 1] };
+
+                strand_copies.push_back({ strand_vertices.size() * sizeof(glm::vec3),
+                                          begin * sizeof(glm::vec3),
+                                          (end - begin) * sizeof(glm::vec3) });
+
+                strand_vertices.insert(strand_vertices.end(), hair_style.get_vertices().begin() + begin,
+                                                              hair_style.get_vertices().begin() + end);
+                strand_tangents.insert(strand_tangents.end(), hair_style.get_tangents().begin() + begin,
+                                                              hair_style.get_tangents().begin() + end);
+            }
+
+            struct StagingBuffer {
+                vk::Buffer buffer;
+                vk::DeviceMemory memory;
+            };
+
+            auto create_staging_buffer = [&](const void* data, VkDeviceSize size) {
+                StagingBuffer staging;
+
+                if (size == 0)
+                    return staging;
+
+                staging.buffer = vk::Buffer {
+                    vulkan_renderer.device,
+                    size,
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                };
+
+                staging.memory = vk::DeviceMemory {
+                    vulkan_renderer.device,
+                    staging.buffer.get_memory_requirements(),
+                    vk::DeviceMemory::Type::HostVisible
+                };
+
+                staging.buffer.bind(staging.memory);
+                staging.memory.copy(size, data);
+
+                return staging;
+            };
+
+            auto density_staging = create_staging_buffer(density_data.data(), density_data.size());
+            auto tangent_staging = create_staging_buffer(tangent_data.data(), tangent_data.size() * sizeof(tangent_data[0]));
+            auto vertex_staging  = create_staging_buffer(strand_vertices.data(), strand_vertices.size() * sizeof(glm::vec3));
+            auto strand_tangent_staging = create_staging_buffer(strand_tangents.data(), strand_tangents.size() * sizeof(glm::vec3));
+
+            auto command_buffer = vulkan_renderer.command_pool.allocate_and_begin();
+
+            if (!changed_bricks.empty()) {
+                density_volume.transition(command_buffer,
+                                          VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                                          density_volume.get_layout(),
+                                          VK_IMAGE_LAYOUT_GENERAL,
+                                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                command_buffer.copy_buffer_image(density_staging.buffer, density_volume, density_copies);
+
+                density_volume.transition(command_buffer,
+                                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                                          VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                                          VK_IMAGE_LAYOUT_GENERAL,
+                                          VK_IMAGE_LAYOUT_GENERAL,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                command_buffer.blit_mip_chain(density_volume, VK_FILTER_LINEAR);
+
+                density_volume.transition(command_buffer,
+                                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                                          VK_ACCESS_SHADER_READ_BIT,
+                                          VK_IMAGE_LAYOUT_GENERAL,
+                                          VK_IMAGE_LAYOUT_GENERAL,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+                tangent_volume.transition(command_buffer,
+                                          VK_ACCESS_SHADER_READ_BIT,
+                                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                                          tangent_volume.get_layout(),
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                command_buffer.copy_buffer_image(tangent_staging.buffer, tangent_volume, tangent_copies);
+
+                tangent_volume.transition(command_buffer,
+                                          VK_ACCESS_TRANSFER_WRITE_BIT,
+                                          VK_ACCESS_SHADER_READ_BIT,
+                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                          VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            }
+
+            command_buffer.copy_buffer(vertex_staging.buffer, vertices, strand_copies);
+            command_buffer.copy_buffer(strand_tangent_staging.buffer, tangents, strand_copies);
+
+            VkMemoryBarrier strand_barrier {  };
+            strand_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            strand_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            strand_barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+            command_buffer.pipeline_barrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                            strand_barrier);
+
+            command_buffer.end();
+
+            vulkan_renderer.command_pool.get_queue().submit(command_buffer)
+                                                    .wait_idle();
+        }
+
+        void HairStyle::upload_volume(vkhr::HairStyle::Volume& strand_volume,
+                                      vk::DeviceImage::Residency residency,
+                                      vkhr::Rasterizer& vulkan_renderer) {
+            constexpr VkImageUsageFlags volume_usage { VK_IMAGE_USAGE_SAMPLED_BIT |
+                                                       VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                                       VK_IMAGE_USAGE_STORAGE_BIT };
+
+            auto density_residency = residency == vk::DeviceImage::Residency::Sparse &&
+                                     vk::DeviceImage::sparse_residency_supported(vulkan_renderer.device, vulkan_renderer.command_pool,
+                                                                                 VK_FORMAT_R8_UNORM, volume_usage)
+                                   ? vk::DeviceImage::Residency::Sparse : vk::DeviceImage::Residency::Full;
+            auto tangent_residency = residency == vk::DeviceImage::Residency::Sparse &&
+                                     vk::DeviceImage::sparse_residency_supported(vulkan_renderer.device, vulkan_renderer.command_pool,
+                                                                                 VK_FORMAT_R8G8B8A8_SNORM, volume_usage)
+                                   ? vk::DeviceImage::Residency::Sparse : vk::DeviceImage::Residency::Full;
+
+            // Density pyramid: the volume itself, and then its averages.
+            auto density_mips = strand_volume.create_mip_chain(vkhr::HairStyle::Volume::average);
+            std::vector<std::vector<unsigned char>> density_mip_chain;
+            density_mip_chain.push_back(std::move(strand_volume.densities));
+            for (auto& mip : density_mips)
+                density_mip_chain.push_back(std::move(mip.densities));
+
+            auto density_mip_levels = static_cast<std::uint32_t>(density_mip_chain.size());
 
             density_sampler = vk::Sampler {
                 vulkan_renderer.device,
                 VK_FILTER_LINEAR,      VK_FILTER_LINEAR,
                 VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
                 VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-                VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
+                VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+                true, false,
+                static_cast<float>(density_mip_levels)
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, density_sampler, VK_OBJECT_TYPE_SAMPLER, "Hair Density Sampler", id);
@@ -97,18 +407,30 @@ namespace vkhr {
                 static_cast<std::uint32_t>(parameters.volume_resolution.y),
                 static_cast<std::uint32_t>(parameters.volume_resolution.z),
                 vulkan_renderer.command_pool,
-                strand_volume.densities
+                density_mip_chain,
+                density_residency
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, density_volume, VK_OBJECT_TYPE_IMAGE, "Hair Density Volume", id);
 
             density_view = vk::ImageView {
                 vulkan_renderer.device,
-                density_volume
+                density_volume,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                density_mip_levels
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, density_view, VK_OBJECT_TYPE_IMAGE_VIEW, "Hair Density View", id);
 
+            // Storage images can only be bound one mip level at a time.
+            density_storage_view = vk::ImageView {
+                vulkan_renderer.device,
+                density_volume,
+                VK_IMAGE_LAYOUT_GENERAL
+            };
+
+            vk::DebugMarker::object_name(vulkan_renderer.device, density_storage_view, VK_OBJECT_TYPE_IMAGE_VIEW, "Hair Density Storage View", id);
+
             tangent_sampler = vk::Sampler {
                 vulkan_renderer.device,
                 VK_FILTER_LINEAR,      VK_FILTER_LINEAR,
@@ -125,7 +447,9 @@ namespace vkhr {
                 static_cast<std::uint32_t>(parameters.volume_resolution.y),
                 static_cast<std::uint32_t>(parameters.volume_resolution.z),
                 vulkan_renderer.command_pool,
-                strand_volume.tangents
+                strand_volume.tangents,
+                1,
+                tangent_residency
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, tangent_volume, VK_OBJECT_TYPE_IMAGE, "Hair Tangent Volume", id);
@@ -136,13 +460,6 @@ namespace vkhr {
             };
 
             vk::DebugMarker::object_name(vulkan_renderer.device, tangent_view, VK_OBJECT_TYPE_IMAGE_VIEW, "Hair Tangent View", id);
-
-            volume = Volume {
-                *this,
-                vulkan_renderer
-            };
-
-            ++id;
         }
 
         void HairStyle::voxelize(Pipeline& voxel_pipeline, vk::DescriptorSet& descriptor_set, vk::CommandBuffer& command_buffer) {
@@ -166,10 +483,141 @@ namespace vkhr {
 
             descriptor_set.write(0, vertices);
             descriptor_set.write(2, parameter_buffer);
-            descriptor_set.write(3, density_view);
+            descriptor_set.write(3, density_storage_view);
 
             command_buffer.bind_descriptor_set(descriptor_set, voxel_pipeline);
-            command_buffer.dispatch((vertices.count()*parameters.strand_ratio) / 512);
+            command_buffer.dispatch((level_of_detail.segment_count + level_of_detail.strand_count) / 512);
+
+            // Only the first level was voxelized, so the rest of the density
+            // pyramid is blitted down from it again, or it would be stale.
+            density_volume.transition(command_buffer,
+                                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                      VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                                      VK_IMAGE_LAYOUT_GENERAL,
+                                      VK_IMAGE_LAYOUT_GENERAL,
+                                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                      VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+            command_buffer.blit_mip_chain(density_volume, VK_FILTER_LINEAR);
+
+            density_volume.transition(command_buffer,
+                                      VK_ACCESS_TRANSFER_WRITE_BIT,
+                                      VK_ACCESS_SHADER_READ_BIT,
+                                      VK_IMAGE_LAYOUT_GENERAL,
+                                      VK_IMAGE_LAYOUT_GENERAL,
+                                      VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+
+        bool HairStyle::load_guide_strands(const vkhr::HairStyle& hair_style,
+                                           vkhr::Rasterizer& vulkan_renderer) {
+            const auto& guide_strands = hair_style.get_guide_strands();
+
+            vertices_per_guide = 0;
+
+            if (guide_strands.get_guide_count() == 0 ||
+                guide_strands.guides.size() != hair_style.get_strand_count() ||
+                hair_style.get_strand_count() == 0)
+                return false;
+
+            // Built from interpolate.comp by its Makefile, which needs glslc.
+            std::error_code error;
+            if (!std::filesystem::exists(SHADER("strands/interpolate.comp.spv"), error))
+                return false;
+
+            const std::uint32_t strand_count { static_cast<std::uint32_t>(hair_style.get_strand_count()) };
+
+            // Padded for std430, where a vec3 array has the stride of a vec4.
+            std::vector<glm::vec4> guide_vertex_data;
+            guide_vertex_data.reserve(guide_strands.vertices.size());
+            for (const auto& guide_vertex : guide_strands.vertices)
+                guide_vertex_data.emplace_back(guide_vertex, 1.0f);
+
+            struct GuidedStrand {
+                glm::uvec4 guides;
+                glm::vec4 weights;
+                glm::vec4 root_offset;
+            };
+
+            std::vector<GuidedStrand> guided_strand_data(strand_count);
+            for (std::size_t strand { 0 }; strand < guided_strand_data.size(); ++strand) {
+                guided_strand_data[strand] = GuidedStrand {
+                    guide_strands.guides[strand],
+                    guide_strands.weights[strand],
+                    glm::vec4 { guide_strands.offsets[strand], 0.0f }
+                };
+            }
+
+            std::vector<unsigned> guided_offsets(hair_style.get_strand_offsets().begin(),
+                                                 hair_style.get_strand_offsets().end());
+
+            strand_offsets = vk::StorageBuffer {
+                vulkan_renderer.device,
+                vulkan_renderer.command_pool,
+                guided_offsets
+            };
+
+            vk::DebugMarker::object_name(vulkan_renderer.device, strand_offsets, VK_OBJECT_TYPE_BUFFER, "Hair Strand Offsets Buffer", id);
+
+            guide_vertices = vk::StorageBuffer {
+                vulkan_renderer.device,
+                vulkan_renderer.command_pool,
+                guide_vertex_data
+            };
+
+            vk::DebugMarker::object_name(vulkan_renderer.device, guide_vertices, VK_OBJECT_TYPE_BUFFER, "Hair Guide Vertices Buffer", id);
+
+            guided_strands = vk::StorageBuffer {
+                vulkan_renderer.device,
+                vulkan_renderer.command_pool,
+                guided_strand_data
+            };
+
+            vk::DebugMarker::object_name(vulkan_renderer.device, guided_strands, VK_OBJECT_TYPE_BUFFER, "Hair Guided Strands Buffer", id);
+
+            guided_strand_count = strand_count;
+            vertices_per_guide = guide_strands.vertices_per_guide;
+
+            return true;
+        }
+
+        bool HairStyle::has_guide_strands() const {
+            return vertices_per_guide != 0;
+        }
+
+        void HairStyle::interpolate(Pipeline& guide_pipeline, vk::DescriptorSet& descriptor_set, vk::CommandBuffer& command_buffer) {
+            if (!has_guide_strands())
+                return;
+
+            descriptor_set.write(0, vertices);
+            descriptor_set.write(1, tangents);
+            descriptor_set.write(2, strand_offsets);
+            descriptor_set.write(3, guide_vertices);
+            descriptor_set.write(4, guided_strands);
+
+            struct Interpolation {
+                std::uint32_t strand_count;
+                std::uint32_t vertices_per_guide;
+            } interpolation {
+                guided_strand_count,
+                vertices_per_guide
+            };
+
+            command_buffer.bind_descriptor_set(descriptor_set, guide_pipeline);
+            command_buffer.push_constant(guide_pipeline, 0, interpolation);
+
+            command_buffer.dispatch((guided_strand_count + 63) / 64);
+
+            // They're read as vertices when drawing, and voxelizing them.
+            VkMemoryBarrier strands_written {
+                VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+            };
+
+            command_buffer.pipeline_barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                            strands_written);
         }
 
         void HairStyle::draw_volume(Pipeline& pipeline, vk::DescriptorSet& descriptor_set, vk::CommandBuffer& command_buffer) {
@@ -185,21 +633,47 @@ namespace vkhr {
                 descriptor_set.write(3, density_view, density_sampler);
             }
 
-            command_buffer.set_line_width(parameters.strand_radius);
+            command_buffer.set_line_width(parameters.strand_radius * level_of_detail.thickness_scale);
 
             command_buffer.bind_descriptor_set(descriptor_set, pipeline);
 
+            if (simplified_level >= 0) {
+                auto& simplified = simplified_geometry[simplified_level];
+
+                command_buffer.bind_vertex_buffer(0, vertices,  0);
+                command_buffer.bind_vertex_buffer(1, tangents,  0);
+                command_buffer.bind_vertex_buffer(2, thickness, 0);
+
+                command_buffer.bind_index_buffer(simplified.segments);
+
+                command_buffer.draw_indexed(simplified.segment_count * 2);
+
+                return;
+            }
+
             command_buffer.bind_vertex_buffer(0, vertices,  0);
             command_buffer.bind_vertex_buffer(1, tangents,  0);
             command_buffer.bind_vertex_buffer(2, thickness, 0);
 
             command_buffer.bind_index_buffer(segments);
 
-            command_buffer.draw_indexed(segments.count() * parameters.strand_ratio);
+            command_buffer.draw_indexed(level_of_detail.segment_count * 2);
         }
 
         void HairStyle::update_parameters() {
-            parameter_buffer.update(parameters);
+            level_of_detail = pointer->get_level_of_detail(parameters.strand_ratio);
+
+            // Same strands in the same order, so only the segments differ.
+            for (auto& simplified : simplified_geometry)
+                simplified.segment_count = simplified.pointer->get_segment_count(level_of_detail.strand_count);
+
+            // Compensate for the strands that we aren't going to draw now.
+            auto compensated_parameters = parameters;
+            compensated_parameters.strand_radius *= level_of_detail.thickness_scale;
+            compensated_parameters.hair_opacity = 1.0f - std::pow(1.0f - parameters.hair_opacity,
+                                                                  level_of_detail.opacity_exponent);
+
+            parameter_buffer.update(compensated_parameters);
         }
 
         void HairStyle::build_pipeline(Pipeline& pipeline, Rasterizer& vulkan_renderer) {
@@ -400,15 +874,82 @@ namespace vkhr {
                                          VK_OBJECT_TYPE_PIPELINE, "Hair Voxel Pipeline");
         }
 
+        void HairStyle::guide_pipeline(Pipeline& pipeline, Rasterizer& vulkan_renderer) {
+            pipeline = Pipeline { /* In the case we are re-creating the pipeline. */ };
+
+            pipeline.shader_stages.emplace_back(vulkan_renderer.device, SHADER("strands/interpolate.comp"));
+
+            vk::DebugMarker::object_name(vulkan_renderer.device, pipeline.shader_stages[0],
+                                         VK_OBJECT_TYPE_SHADER_MODULE, "Hair Interpolation Shader");
+
+            pipeline.descriptor_set_layout = vk::DescriptorSet::Layout {
+                vulkan_renderer.device,
+                {
+                    { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+                    { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+                    { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+                    { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+                    { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER }
+                }
+            };
+
+            vk::DebugMarker::object_name(vulkan_renderer.device, pipeline.descriptor_set_layout,
+                                         VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT, "Hair Interpolation Descriptor Set Layout");
+            pipeline.descriptor_sets = vulkan_renderer.descriptor_pool.allocate(vulkan_renderer.swap_chain.size(),
+                                                                                pipeline.descriptor_set_layout,
+                                                                                "Hair Interpolation Descriptor Set");
+
+            pipeline.pipeline_layout = vk::Pipeline::Layout {
+                vulkan_renderer.device,
+                pipeline.descriptor_set_layout,
+                {
+                    { VK_SHADER_STAGE_ALL, 0, 2 * sizeof(std::uint32_t) } // strand count, vertices per guide.
+                }
+            };
+
+            vk::DebugMarker::object_name(vulkan_renderer.device, pipeline.pipeline_layout,
+                                         VK_OBJECT_TYPE_PIPELINE_LAYOUT,
+                                         "Hair Interpolation Pipeline Layout");
+
+            pipeline.compute_pipeline = vk::ComputePipeline {
+                vulkan_renderer.device,
+                pipeline.shader_stages[0],
+                pipeline.pipeline_layout
+            };
+
+            vk::DebugMarker::object_name(vulkan_renderer.device, pipeline.compute_pipeline,
+                                         VK_OBJECT_TYPE_PIPELINE, "Hair Interpolation Pipeline");
+        }
+
         void HairStyle::reduce(float ratio) {
             parameters.strand_ratio = ratio;
+            update_parameters();
+        }
+
+        void HairStyle::simplify(float max_error) {
+            simplified_level = -1;
+
+            // They're sorted from the finest to the coarsest simplification.
+            for (std::size_t level { 0 }; level < simplified_geometry.size(); ++level)
+                if (simplified_geometry[level].pointer->max_error <= max_error)
+                    simplified_level = static_cast<int>(level);
         }
 
         std::size_t HairStyle::get_geometry_size() const {
-            return segments.get_size() +
-                   vertices.get_size() +
-                   tangents.get_size() +
-                   thickness.get_size();
+            std::size_t geometry_size = segments.get_size() +
+                                        vertices.get_size() +
+                                        tangents.get_size() +
+                                        thickness.get_size();
+
+            if (has_guide_strands())
+                geometry_size += strand_offsets.get_size() +
+                                 guide_vertices.get_size() +
+                                 guided_strands.get_size();
+
+            for (const auto& simplified : simplified_geometry)
+                geometry_size += simplified.segments.get_size();
+
+            return geometry_size;
         }
 
         std::size_t HairStyle::get_volume_size() const {
@@ -305,6 +305,14 @@ namespace vkhr {
                     ImGui::SameLine();
                     if (ImGui::Checkbox("Shadow Rays", &ray_tracer.shadows_on))
                         ray_tracer.now_dirty = true;
+                    bool ray_packets { ray_tracer.tracing_mode == Raytracer::TracingMode::RayPackets };
+                    if (ImGui::Checkbox("Ray Packets", &ray_packets))
+                        ray_tracer.set_tracing_mode(ray_packets ? Raytracer::TracingMode::RayPackets
+                                                                : Raytracer::TracingMode::SingleRays);
+                    ImGui::PushItemWidth(171);
+                    if (ImGui::SliderFloat("Target Error", &ray_tracer.target_error, 0.000, 0.100, "%.3f"))
+                        ray_tracer.now_dirty = true;
+                    ImGui::PopItemWidth();
                     ImGui::TreePop();
                 }
 
@@ -11,7 +11,9 @@
 
 #include <limits>
 #include <vector>
+#include <unordered_map>
 #include <cmath>
+#include <algorithm>
 
 namespace vkhr {
     static void embree_debug_callback(void*, const RTCError code,
@@ -25,22 +27,47 @@ namespace vkhr {
         }
     }
 
-    Raytracer::Raytracer(const SceneGraph& scene_graph) {
+    static bool embree_memory_monitor(void* memory_usage, ssize_t bytes, bool) {
+        *static_cast<std::atomic<std::ptrdiff_t>*>(memory_usage) += bytes;
+        return true;
+    }
+
+    RTCSceneFlags Raytracer::BuildOptions::get_scene_flags() const {
+        int scene_flags { RTC_SCENE_FLAG_NONE };
+        if (compact) scene_flags |= RTC_SCENE_FLAG_COMPACT;
+        if (robust)  scene_flags |= RTC_SCENE_FLAG_ROBUST;
+        return static_cast<RTCSceneFlags>(scene_flags);
+    }
+
+    Raytracer::Raytracer(const SceneGraph& scene_graph)
+              : Raytracer { scene_graph, BuildOptions { } } {  }
+
+    Raytracer::Raytracer(const SceneGraph& scene_graph, const BuildOptions& build_options)
+                         : build_options { build_options } {
         set_flush_to_zero();
         set_denormal_zero();
 
-        device = rtcNewDevice("verbose=1");
+        std::string device_config { "verbose=" + std::to_string(build_options.verbose) };
+        if (build_options.threads != 0)
+            device_config += ",threads=" + std::to_string(build_options.threads);
+
+        device = rtcNewDevice(device_config.c_str());
 
         rtcSetDeviceErrorFunction(device, embree_debug_callback, nullptr);
 
-        std::random_device rng; seed=rng(); 
+        memory_usage = std::make_unique<std::atomic<std::ptrdiff_t>>(0);
+        rtcSetDeviceMemoryMonitorFunction(device, embree_memory_monitor, memory_usage.get());
+
+        sampler = Sampler::create(Sampler::Type::Sobol, std::random_device { }());
 
         load(scene_graph);
     }
 
     Raytracer::~Raytracer() noexcept {
-        rtcReleaseScene(scene);
-        rtcReleaseDevice(device);
+        if (scene != nullptr)
+            rtcReleaseScene(scene);
+        if (device != nullptr)
+            rtcReleaseDevice(device);
     }
 
     void Raytracer::load(const SceneGraph& scene_graph) {
@@ -51,18 +78,50 @@ namespace vkhr {
 
         scene = rtcNewScene(device);
 
+        // The top-level scene only has a few instances, which are moved.
+        rtcSetSceneFlags(scene, static_cast<RTCSceneFlags>(build_options.get_scene_flags() |
+                                                           RTC_SCENE_FLAG_DYNAMIC));
+        rtcSetSceneBuildQuality(scene, RTC_BUILD_QUALITY_LOW);
+
+        hair_styles.clear();
+        models.clear();
+        instances.clear();
+
+        // Nodes can share a style, so only build its geometry once.
+        std::unordered_map<const HairStyle*, std::size_t> loaded_hair_styles;
+
         // Load only the set of hair styles which are within the actual scene graph.
         for (const auto& hair_style_node : scene_graph.get_nodes_with_hair_styles()) {
             for (const auto hair_style : hair_style_node->get_hair_styles()) {
-                auto hair = embree::HairStyle { *hair_style, *this };
-                if (hair.get_geometry() >= hair_styles.size())
-                    hair_styles.resize(hair.get_geometry()+1);
-                hair_styles[hair.get_geometry()] = std::move(hair);
+                auto loaded_hair_style = loaded_hair_styles.find(hair_style);
+                if (loaded_hair_style == loaded_hair_styles.end()) {
+                    loaded_hair_style = loaded_hair_styles.emplace(hair_style, hair_styles.size()).first;
+                    hair_styles.emplace_back(*hair_style, *this);
+                }
+
+                add_instance(*hair_style_node, Instance::Type::HairStyle, loaded_hair_style->second);
+            }
+        }
+
+        // Meshes (e.g. the scalp and body) occlude the strands as well.
+        std::unordered_map<const Model*, std::size_t> loaded_models;
+
+        for (const auto& model_node : scene_graph.get_nodes_with_models()) {
+            for (const auto model : model_node->get_models()) {
+                auto loaded_model = loaded_models.find(model);
+                if (loaded_model == loaded_models.end()) {
+                    loaded_model = loaded_models.emplace(model, models.size()).first;
+                    models.emplace_back(*model, *this);
+                }
+
+                add_instance(*model_node, Instance::Type::Model, loaded_model->second);
             }
         }
 
         rtcCommitScene(scene);
 
+        transform_revision = scene_graph.get_transform_revision();
+
         framebuffer = Image {
             scene_graph.get_camera().get_width(),
             scene_graph.get_camera().get_height()
@@ -73,96 +132,397 @@ namespace vkhr {
         clear();
     }
 
+    void Raytracer::add_instance(const SceneGraph::Node& node, Instance::Type type, std::size_t index) {
+        auto instance_geometry = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_INSTANCE);
+
+        if (type == Instance::Type::HairStyle)
+            rtcSetGeometryInstancedScene(instance_geometry, hair_styles[index].get_scene());
+        else rtcSetGeometryInstancedScene(instance_geometry, models[index].get_scene());
+
+        rtcSetGeometryTimeStepCount(instance_geometry, 1);
+        rtcSetGeometryTransform(instance_geometry, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+                                &node.get_model_matrix()[0][0]);
+
+        rtcCommitGeometry(instance_geometry);
+        auto geometry = rtcAttachGeometry(scene, instance_geometry);
+        rtcReleaseGeometry(instance_geometry);
+
+        if (geometry >= instances.size())
+            instances.resize(geometry + 1);
+
+        instances[geometry] = { &node, type, index };
+        instances[geometry].set_model_matrix(node.get_model_matrix());
+    }
+
+    void Raytracer::Instance::set_model_matrix(const glm::mat4& model_matrix) {
+        this->model_matrix  = model_matrix;
+        this->normal_matrix = glm::transpose(glm::inverse(glm::mat3 { model_matrix }));
+    }
+
+    void Raytracer::update_instances(const SceneGraph& scene_graph) {
+        if (scene_graph.get_transform_revision() == transform_revision)
+            return;
+
+        for (unsigned geometry { 0 }; geometry < instances.size(); ++geometry) {
+            auto& instance = instances[geometry];
+            if (instance.node == nullptr || instance.model_matrix == instance.node->get_model_matrix())
+                continue;
+
+            instance.set_model_matrix(instance.node->get_model_matrix());
+
+            auto instance_geometry = rtcGetGeometry(scene, geometry);
+            rtcSetGeometryTransform(instance_geometry, 0, RTC_FORMAT_FLOAT4X4_COLUMN_MAJOR,
+                                    &instance.model_matrix[0][0]);
+            rtcCommitGeometry(instance_geometry);
+        }
+
+        // Only refits the instances, the styles' and models' BVH are left as is.
+        rtcCommitScene(scene);
+
+        transform_revision = scene_graph.get_transform_revision();
+
+        now_dirty = true;
+    }
+
+    bool Raytracer::update_hair_style(const HairStyle& hair_style) {
+        for (std::size_t i { 0 }; i < hair_styles.size(); ++i) {
+            if (hair_styles[i].get_pointer() != &hair_style)
+                continue;
+
+            auto refitted = hair_styles[i].update(hair_style, *this);
+
+            // The instances' bounds depend on the instanced scene's bounds.
+            for (unsigned geometry { 0 }; geometry < instances.size(); ++geometry) {
+                if (instances[geometry].node != nullptr && instances[geometry].type == Instance::Type::HairStyle
+                                                        && instances[geometry].index == i)
+                    rtcCommitGeometry(rtcGetGeometry(scene, geometry));
+            }
+
+            rtcCommitScene(scene);
+
+            now_dirty = true;
+
+            return refitted;
+        }
+
+        return false;
+    }
+
+    const Raytracer::BuildOptions& Raytracer::get_build_options() const {
+        return build_options;
+    }
+
+    const std::vector<embree::HairStyle>& Raytracer::get_hair_styles() const {
+        return hair_styles;
+    }
+
+    std::size_t Raytracer::get_memory_usage() const {
+        return static_cast<std::size_t>(std::max<std::ptrdiff_t>(*memory_usage, 0));
+    }
+
     void Raytracer::draw(const SceneGraph& scene_graph) {
+        update_instances(scene_graph);
+
         if (now_dirty)
             clear();
 
-        auto& viewing_plane = scene_graph.get_camera().get_viewing_plane();
-
         auto& camera = scene_graph.get_camera();
         auto& light  = scene_graph.get_light_sources().front();
 
-        #pragma omp parallel for schedule(dynamic)
-        for (int j = 0; j < static_cast<int>(framebuffer.get_height()); ++j)
-        for (int i = 0; i < static_cast<int>(framebuffer.get_width());  ++i) {
-            float x { static_cast<float>(i) },
-                  y { static_cast<float>(j) };
+        const int width  { static_cast<int>(framebuffer.get_width())  },
+                  height { static_cast<int>(framebuffer.get_height()) };
 
-            glm::dvec3 sample_color { 1.000, 1.000, 1.000 };
+        const int horizontal_tiles { (width  + TileSize - 1) / TileSize },
+                  vertical_tiles   { (height + TileSize - 1) / TileSize };
+
+        std::size_t traced_rays { 0 };
+
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:traced_rays)
+        for (int tile = 0; tile < horizontal_tiles * vertical_tiles; ++tile) {
+            glm::ivec2 tile_begin { (tile % horizontal_tiles) * TileSize,
+                                    (tile / horizontal_tiles) * TileSize };
+            glm::ivec2 tile_end { glm::min(tile_begin + TileSize, glm::ivec2 { width, height }) };
+
+            if (tracing_mode == TracingMode::RayPackets)
+                traced_rays += trace_packets(tile_begin, tile_end, camera, light);
+            else traced_rays += trace_rays(tile_begin, tile_end, camera, light);
+        }
 
-            RTCIntersectContext      context;
-            rtcInitIntersectContext(&context);
+        ray_count = traced_rays;
 
-            glm::vec2 jitter {
-                sample(0.0f, 1.0f),
-                sample(0.0f, 1.0f)
-            };
+        converged_pixels = std::count(converged.begin(), converged.end(), 1);
 
-            auto direction = ((x + jitter.x) * viewing_plane.x +
-                              (y + jitter.y) * viewing_plane.y +
-                                               viewing_plane.z);
+        ++samples;
+
+        framebuffer.clear();
+        framebuffer.copy(back_buffer, sample_counts);
+    }
+
+    std::size_t Raytracer::trace_rays(const glm::ivec2& tile_begin, const glm::ivec2& tile_end,
+                                      const Camera& camera, const LightSource& light) {
+        const int width { static_cast<int>(framebuffer.get_width()) };
+
+        std::size_t traced_rays { 0 };
+
+        for (int j = tile_begin.y; j < tile_end.y; ++j)
+        for (int i = tile_begin.x; i < tile_end.x; ++i) {
+            std::size_t pixel { static_cast<std::size_t>(i + j * width) };
+
+            if (converged[pixel])
+                continue;
+
+            glm::dvec3 sample_color { 1.000, 1.000, 1.000 };
+
+            OcclusionContext context;
+            rtcInitIntersectContext(&context.context);
 
-            Ray ray { viewing_plane.point, direction, 0.0000f };
+            SampleSequence sample_sequence { *sampler, glm::uvec2 { i, j }, sample_counts[pixel] };
 
-            if (ray.intersects(scene, context)) {
-                glm::vec3 position { ray.get_intersection_point() };
+            Ray ray { create_primary_ray(i, j, camera, sample_sequence) };
 
-                sample_color = light_shading(ray, camera, light, context);
+            ++traced_rays;
+
+            if (ray.intersects(scene, context.context)) {
+                sample_color = light_shading(ray, camera, light, context, sample_sequence);
 
                 if (visualization_method != DirectShadows) {
-                    sample_color *= ambient_occlusion(position,  context);
+                    sample_color *= ambient_occlusion(ray, context, sample_sequence);
                 }
+
+                traced_rays += casts_shadow_rays() + (visualization_method != DirectShadows);
             }
 
-            back_buffer[i + j * framebuffer.get_width()] += sample_color;
+            accumulate(pixel, sample_color);
         }
 
-        ++samples;
+        return traced_rays;
+    }
 
-        framebuffer.clear();
-        framebuffer.copy(back_buffer, samples);
+    std::size_t Raytracer::trace_packets(const glm::ivec2& tile_begin, const glm::ivec2& tile_end,
+                                         const Camera& camera, const LightSource& light) {
+        const int width { static_cast<int>(framebuffer.get_width()) };
+
+        std::vector<Ray> primary_rays;
+        std::vector<SampleSequence> sample_sequences;
+        std::vector<std::size_t> pixels;
+
+        primary_rays.reserve(TileSize * TileSize);
+        sample_sequences.reserve(TileSize * TileSize);
+        pixels.reserve(TileSize * TileSize);
+
+        // Neighbouring pixels in a row go in the same packet, since their
+        // rays are the most coherent, and will visit the same BVH nodes.
+        for (int j = tile_begin.y; j < tile_end.y; ++j)
+        for (int i = tile_begin.x; i < tile_end.x; ++i) {
+            std::size_t pixel { static_cast<std::size_t>(i + j * width) };
+
+            if (converged[pixel])
+                continue;
+
+            sample_sequences.emplace_back(*sampler, glm::uvec2 { i, j }, sample_counts[pixel]);
+            primary_rays.push_back(create_primary_ray(i, j, camera, sample_sequences.back()));
+            pixels.push_back(pixel);
+        }
+
+        RTCIntersectContext primary_context;
+        rtcInitIntersectContext(&primary_context);
+        primary_context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+        Ray::intersect_packets(primary_rays, scene, primary_context);
+
+        // Then the secondary rays of all of the hits, traced as streams. We
+        // use the sample dimensions in the same order as trace_rays(), so it
+        // gives the same samples (and image) as the single ray path does.
+        std::vector<Ray> shadow_rays, ambient_rays;
+        std::vector<std::size_t> hits;
+
+        for (std::size_t ray { 0 }; ray < primary_rays.size(); ++ray) {
+            if (!primary_rays[ray].hit_surface())
+                continue;
+
+            hits.push_back(ray);
+
+            shadow_rays.push_back(create_shadow_ray(primary_rays[ray], light, sample_sequences[ray]));
+
+            if (visualization_method != DirectShadows)
+                ambient_rays.push_back(create_ambient_ray(primary_rays[ray], sample_sequences[ray]));
+        }
+
+        OcclusionContext secondary_context;
+        rtcInitIntersectContext(&secondary_context.context);
+
+        if (!casts_shadow_rays()) shadow_rays.clear();
+
+        std::vector<Transmittance> shadow_transmittance(shadow_rays.size());
+        for (std::size_t ray { 0 }; ray < shadow_rays.size(); ++ray)
+            shadow_rays[ray].set_id(static_cast<unsigned>(ray));
+
+        secondary_context.transmittance = shadow_transmittance.data();
+        Ray::occluded_by_stream(shadow_rays,  scene, secondary_context.context);
+        secondary_context.transmittance = nullptr;
+        Ray::occluded_by_stream(ambient_rays, scene, secondary_context.context);
+
+        for (std::size_t ray { 0 }; ray < primary_rays.size(); ++ray) {
+            if (!primary_rays[ray].hit_surface())
+                accumulate(pixels[ray], glm::dvec3 { 1.000, 1.000, 1.000 });
+        }
+
+        for (std::size_t hit { 0 }; hit < hits.size(); ++hit) {
+            const auto& ray = primary_rays[hits[hit]];
+
+            float light_visibility { 1.0f };
+            if (!shadow_rays.empty())
+                light_visibility = shadow_rays[hit].is_occluded() ? 0.0f : shadow_transmittance[hit].value;
+
+            glm::dvec3 sample_color { shade(ray, camera, light, light_visibility) };
+
+            if (visualization_method != DirectShadows)
+                sample_color *= ambient_rays[hit].is_occluded() ? 0.0f : 2.0f;
+
+            accumulate(pixels[hits[hit]], sample_color);
+        }
+
+        return primary_rays.size() + shadow_rays.size() + ambient_rays.size();
     }
 
-    glm::vec3 Raytracer::light_shading(const Ray& ray, const Camera& camera, const LightSource& light, RTCIntersectContext& context) {
+    Ray Raytracer::create_primary_ray(int i, int j, const Camera& camera, SampleSequence& sample_sequence) {
+        auto& viewing_plane = camera.get_viewing_plane();
+
+        float x { static_cast<float>(i) },
+              y { static_cast<float>(j) };
+
+        glm::vec2 jitter { sample_sequence.next_2d() };
+
+        auto direction = ((x + jitter.x) * viewing_plane.x +
+                          (y + jitter.y) * viewing_plane.y +
+                                           viewing_plane.z);
+
+        return Ray { viewing_plane.point, direction, 0.0000f };
+    }
+
+    Ray Raytracer::create_shadow_ray(const Ray& ray, const LightSource& light, SampleSequence& sample_sequence) {
+        glm::vec2 light_sample { sample_sequence.next_2d() };
         glm::vec3 light_jitter {
-            sample(-16.0f, 16.0f),
-            sample(-16.0f, 16.0f),
-            sample(-16.0f, 16.0f)
+            light_sample.x,
+            light_sample.y,
+            sample_sequence.next_1d()
         };
 
-        Ray shadow_ray {
+        light_jitter = light_jitter * 32.0f - 16.0f;
+
+        auto surface_position = ray.get_intersection_point();
+        auto light_direction = light.get_spotlight_origin() + light_jitter - surface_position;
+
+        // Stops at the light, or meshes behind it would shadow us as well.
+        return Ray {
+            surface_position,
+            glm::normalize(light_direction),
+            Ray::Epsilon,
+            glm::length(light_direction)
+        };
+    }
+
+    Ray Raytracer::create_ambient_ray(const Ray& ray, SampleSequence& sample_sequence) {
+        glm::vec3 direction;
+
+        // Strands don't have a hemisphere (only a tangent), so they use the
+        // whole sphere, while surfaces use a cosine-weighted one around it.
+        if (hit_hair_style(ray)) {
+            direction = Sampler::uniform_sphere(sample_sequence.next_2d());
+        } else {
+            // Embree gives the instance's geometric normal in its own space.
+            const auto& instance = instances[ray.get_instance_id()];
+            glm::vec3 normal { glm::normalize(instance.normal_matrix * ray.get_normal()) };
+            if (glm::dot(normal, ray.get_direction()) > 0.0f)
+                normal = -normal; // facing away from us.
+            direction = Sampler::cosine_hemisphere(sample_sequence.next_2d(), normal);
+        }
+
+        return Ray {
             ray.get_intersection_point(),
-            light.get_spotlight_origin() + light_jitter,
-            Ray::Epsilon
+            direction,
+            Ray::Epsilon,
+            ao_radius
         };
+    }
+
+    bool Raytracer::hit_hair_style(const Ray& ray) const {
+        return ray.get_instance_id() < instances.size() &&
+               instances[ray.get_instance_id()].node != nullptr &&
+               instances[ray.get_instance_id()].type == Instance::Type::HairStyle;
+    }
+
+    void Raytracer::accumulate(std::size_t pixel, const glm::dvec3& sample_color) {
+        const glm::dvec3 luminance_weights { 0.2126, 0.7152, 0.0722 };
+
+        double luminance { glm::dot(sample_color, luminance_weights) };
 
+        back_buffer[pixel] += sample_color;
+        luminance_squares[pixel] += luminance * luminance;
+
+        double n = ++sample_counts[pixel];
+
+        if (target_error <= 0.0f || n < minimum_samples)
+            return;
+
+        double mean { glm::dot(back_buffer[pixel], luminance_weights) / n };
+        double variance { std::max((luminance_squares[pixel] - n * mean * mean) / (n - 1.0), 0.0) };
+
+        // The standard error of the mean, i.e. how far off the estimate is.
+        double standard_error { std::sqrt(variance / n) };
+
+        // If nothing different was hit in n samples, there could still be
+        // something covering up to 3/n of the pixel (with 95% confidence),
+        // which would change it by up to its luminance, or 1 if it's dark.
+        double unseen_error { 3.0 / n * std::max(mean, 1.0) };
+
+        if (std::max(standard_error, unseen_error) <= target_error)
+            converged[pixel] = 1;
+    }
+
+    bool Raytracer::casts_shadow_rays() const {
+        return shadows_on && visualization_method != AmbientOcclusion;
+    }
+
+    glm::vec3 Raytracer::shade(const Ray& ray, const Camera& camera, const LightSource& light, float light_visibility) {
         if (visualization_method == AmbientOcclusion) {
             return glm::vec3 { 1.0f };
-        } else if (!shadow_ray.occluded_by(scene, context) || !shadows_on) {
+        } else if (light_visibility > 0.0f) {
             if (visualization_method == Shaded) {
-                return hair_styles[ray.get_geometry_id()].shade(ray, light, camera);
+                const auto& instance = instances[ray.get_instance_id()];
+                if (instance.type == Instance::Type::HairStyle)
+                    return hair_styles[instance.index].shade(ray, light, camera, instance.model_matrix) * light_visibility;
+                else return models[instance.index].shade(ray, light, camera, instance.normal_matrix) * light_visibility;
             } else {
-                return glm::vec3 { 1.0f };
+                return glm::vec3 { light_visibility };
             }
         } else {
             return glm::vec3 { 0.0f };
         }
     }
 
-    float Raytracer::ambient_occlusion(const glm::vec3& position, RTCIntersectContext& context) {
-        auto random_direction = glm::vec3 {
-            sample(-1.0f, +1.0f),
-            sample(-1.0f, +1.0f),
-            sample(-1.0f, +1.0f)
-        };
+    glm::vec3 Raytracer::light_shading(const Ray& ray, const Camera& camera, const LightSource& light, OcclusionContext& context,
+                                       SampleSequence& sample_sequence) {
+        Ray shadow_ray { create_shadow_ray(ray, light, sample_sequence) };
 
-        Ray random_ray {
-            position,
-            random_direction,
-            Ray::Epsilon
-        };
+        float light_visibility { 1.0f };
+
+        if (casts_shadow_rays()) {
+            Transmittance transmittance;
+            context.transmittance = &transmittance; // the ray's ID is 0.
+            if (shadow_ray.occluded_by(scene, context.context))
+                light_visibility = 0.0f;
+            else light_visibility = transmittance.value;
+            context.transmittance = nullptr;
+        }
+
+        return shade(ray, camera, light, light_visibility);
+    }
+
+    float Raytracer::ambient_occlusion(const Ray& ray, OcclusionContext& context, SampleSequence& sample_sequence) {
+        Ray ambient_ray { create_ambient_ray(ray, sample_sequence) };
 
-        if (!random_ray.occluded_by(scene, context, ao_radius))
+        if (!ambient_ray.occluded_by(scene, context.context))
             return 2.0f;
         else
             return 0.0f;
@@ -185,6 +545,10 @@ namespace vkhr {
         std::fill(back_buffer.begin(),
                   back_buffer.end(),
                   glm::vec3 { 0.0 });
+        luminance_squares.assign(back_buffer.size(), 0.0);
+        sample_counts.assign(back_buffer.size(), 0);
+        converged.assign(back_buffer.size(), 0);
+        converged_pixels = 0;
         now_dirty = false;
     }
 
@@ -203,6 +567,15 @@ namespace vkhr {
         shadows_on = !shadows_on;
     }
 
+    void Raytracer::set_visualization_method(VisualizationMethod visualization_method) {
+        this->visualization_method = visualization_method;
+        now_dirty = true;
+    }
+
+    Raytracer::VisualizationMethod Raytracer::get_visualization_method() const {
+        return visualization_method;
+    }
+
     Raytracer::Raytracer(Raytracer&& raytracer) noexcept {
         swap(*this, raytracer);
     }
@@ -214,7 +587,30 @@ namespace vkhr {
 
     void swap(Raytracer& lhs, Raytracer& rhs) {
         using std::swap;
-        std::swap(lhs.device, rhs.device);
+        swap(lhs.instances, rhs.instances);
+        swap(lhs.transform_revision, rhs.transform_revision);
+        swap(lhs.shadows_on, rhs.shadows_on);
+        swap(lhs.now_dirty, rhs.now_dirty);
+        swap(lhs.visualization_method, rhs.visualization_method);
+        swap(lhs.tracing_mode, rhs.tracing_mode);
+        swap(lhs.ray_count, rhs.ray_count);
+        swap(lhs.build_options, rhs.build_options);
+        swap(lhs.memory_usage, rhs.memory_usage);
+        swap(lhs.device, rhs.device);
+        swap(lhs.scene, rhs.scene);
+        swap(lhs.ao_radius, rhs.ao_radius);
+        swap(lhs.samples, rhs.samples);
+        swap(lhs.back_buffer, rhs.back_buffer);
+        swap(lhs.luminance_squares, rhs.luminance_squares);
+        swap(lhs.sample_counts, rhs.sample_counts);
+        swap(lhs.converged, rhs.converged);
+        swap(lhs.target_error, rhs.target_error);
+        swap(lhs.minimum_samples, rhs.minimum_samples);
+        swap(lhs.converged_pixels, rhs.converged_pixels);
+        swap(lhs.sampler, rhs.sampler);
+        swap(lhs.framebuffer, rhs.framebuffer);
+        swap(lhs.hair_styles, rhs.hair_styles);
+        swap(lhs.models, rhs.models);
     }
 
     void Raytracer::set_flush_to_zero() {
@@ -225,83 +621,51 @@ namespace vkhr {
         _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
     }
 
-    std::uint32_t Raytracer::xorshift() {
-        std::uint32_t x = seed;
-        x ^= x << 13;
-        x ^= x >> 7;
-        x ^= x << 17;
-        seed = x;
-        return x;
-    }
-
-    float Raytracer::sample(float min, float max) {
-        float random_number = xorshift();
-        float range = max - min;
-        float normalization = std::numeric_limits<std::uint32_t>::max();
-        return (random_number / normalization) * range + min;
-    }
-
-    // From: "Correlated Multi-Jitter Sampling" by Pixar:
-
-    float Raytracer::rand_float(unsigned i, unsigned p) {
-        i ^= p;
-        i ^= i >> 17;
-        i ^= i >> 10;
-        i *= 0xb36534e5;
-        i ^= i >> 12;
-        i ^= i >> 21;
-        i *= 0x93fc4795;
-        i ^= 0xdf6e307f;
-        i ^= i >> 17;
-        i *= 1 | p >> 18;
-        return i * (1.0f / 4294967808.0f);
-    }
-
-    unsigned Raytracer::permute(unsigned i, unsigned l, unsigned p) {
-        unsigned w = l - 1;
-
-        w |= w >> 1;
-        w |= w >> 2;
-        w |= w >> 4;
-        w |= w >> 8;
-        w |= w >> 16;
-
-        do {
-            i ^= p;
-            i *= 0xe170893d;
-            i ^= p >> 16;
-            i ^= (i & w) >> 4;
-            i ^= p >> 8;
-            i *= 0x0929eb3f;
-            i ^= p >> 23;
-            i ^= (i & w) >> 1;
-            i *= 1 | p >> 27;
-            i *= 0x6935fa69;
-            i ^= (i & w) >> 11;
-            i *= 0x74dcb303;
-            i ^= (i & w) >> 2;
-            i *= 0x9e501cc3;
-            i ^= (i & w) >> 2;
-            i *= 0xc860a3df;
-            i &= w;
-            i ^= i >> 5;
-        } while (i >= l);
-
-        return (i + p) % l;
-    }
-
-    glm::vec2 Raytracer::cmj(int s, int m, int n, int p) {
-        int sx = permute(s % m, m, p * 0xa511e9b3),
-            sy = permute(s / m, n, p * 0x63d83595);
-
-        float jx = rand_float(s, p * 0xa399d265),
-              jy = rand_float(s, p * 0x711ad6a5);
-
-        glm::vec2 r = {
-            (s % m + (sy + jx) / n) / m,
-            (s / m + (sx + jy) / m) / n
-        };
+    void Raytracer::set_tracing_mode(TracingMode tracing_mode) {
+        this->tracing_mode = tracing_mode;
+    }
+
+    Raytracer::TracingMode Raytracer::get_tracing_mode() const {
+        return tracing_mode;
+    }
+
+    std::size_t Raytracer::get_ray_count() const {
+        return ray_count;
+    }
+
+    void Raytracer::set_target_error(float target_error, std::size_t minimum_samples) {
+        this->target_error    = target_error;
+        this->minimum_samples = std::max(minimum_samples, std::size_t { 2 });
+        now_dirty = true;
+    }
+
+    float Raytracer::get_target_error() const {
+        return target_error;
+    }
+
+    std::size_t Raytracer::get_converged_pixel_count() const {
+        return converged_pixels;
+    }
+
+    bool Raytracer::is_converged() const {
+        return target_error > 0.0f && converged_pixels == back_buffer.size();
+    }
+
+    void Raytracer::set_seed(std::uint32_t seed) {
+        sampler->set_seed(seed);
+        now_dirty = true;
+    }
+
+    std::uint32_t Raytracer::get_seed() const {
+        return sampler->get_seed();
+    }
+
+    void Raytracer::set_sampler(Sampler::Type sampler_type) {
+        sampler = Sampler::create(sampler_type, sampler->get_seed());
+        now_dirty = true;
+    }
 
-        return r;
+    Sampler::Type Raytracer::get_sampler_type() const {
+        return sampler->get_type();
     }
 }
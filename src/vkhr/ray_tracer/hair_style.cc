@@ -2,6 +2,9 @@
 
 #include <vkhr/ray_tracer.hh>
 
+#include <algorithm>
+#include <chrono>
+
 namespace vkhr {
     namespace embree {
         HairStyle::HairStyle(const vkhr::HairStyle& hair_style,
@@ -11,11 +14,20 @@ namespace vkhr {
 
         void HairStyle::load(const vkhr::HairStyle& hair_style,
                              const vkhr::Raytracer& raytracer) {
-            const auto& indices = hair_style.get_indices();
+            const auto indices  = hair_style.get_indices();
+            const auto tangents = hair_style.get_tangents();
 
             position_thickness = hair_style.create_position_thickness_data();
 
-            auto hair_geometry = rtcNewGeometry(raytracer.device, RTC_GEOMETRY_TYPE_FLAT_LINEAR_CURVE);
+            const auto& build_options = raytracer.get_build_options();
+
+            auto curve_type = RTC_GEOMETRY_TYPE_FLAT_LINEAR_CURVE;
+            if (build_options.curve == Raytracer::BuildOptions::Curve::FlatBSpline)
+                curve_type = RTC_GEOMETRY_TYPE_FLAT_BSPLINE_CURVE;
+            else if (build_options.curve == Raytracer::BuildOptions::Curve::RoundBSpline)
+                curve_type = RTC_GEOMETRY_TYPE_ROUND_BSPLINE_CURVE;
+
+            auto hair_geometry = rtcNewGeometry(raytracer.device, curve_type);
 
             rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT4,
                                        position_thickness.data(),
@@ -25,32 +37,252 @@ namespace vkhr {
             rtcSetGeometryVertexAttributeCount(hair_geometry, 1);
 
             rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, RTC_FORMAT_FLOAT3,
-                                       hair_style.tangents.data(),
-                                       0, sizeof(hair_style.tangents[0]),
-                                       hair_style.tangents.size());
+                                       tangents.data(),
+                                       0, sizeof(tangents[0]),
+                                       tangents.size());
+
+            curve_indices.clear();
+
+            if (curve_type == RTC_GEOMETRY_TYPE_FLAT_LINEAR_CURVE) {
+                rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT,
+                                           indices.data(),
+                                           0, sizeof(indices[0]) * 2,
+                                           indices.size() / 2);
+                segment_count = indices.size() / 2;
+            } else {
+                // B-spline segments start at their first of 4 control points,
+                // so they're only the line segments two before another one.
+                for (std::size_t i { 0 }; i + 4 < indices.size(); i += 2) {
+                    if (indices[i + 4] == indices[i] + 2)
+                        curve_indices.push_back(indices[i]);
+                }
+
+                rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT,
+                                           curve_indices.data(),
+                                           0, sizeof(curve_indices[0]),
+                                           curve_indices.size());
+                segment_count = curve_indices.size();
+            }
+
+            segment_opacity.assign(segment_count, hair_style.get_default_transparency());
+
+            if (hair_style.has_transparency()) {
+                const auto transparency = hair_style.get_transparency();
+                for (std::size_t segment { 0 }; segment < segment_count; ++segment) {
+                    auto vertex = curve_indices.empty() ? indices[2 * segment] : curve_indices[segment] + 1;
+                    segment_opacity[segment] = transparency[vertex];
+                }
+            }
+
+            rtcSetGeometryUserData(hair_geometry, segment_opacity.data());
+            rtcSetGeometryOccludedFilterFunction(hair_geometry, occlusion_filter);
 
-            rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT,
-                                       indices.data(),
-                                       0, sizeof(indices[0]) * 2,
-                                       indices.size() / 2);
+            build_quality = build_options.quality;
+            rtcSetGeometryBuildQuality(hair_geometry, build_quality);
+
+            // Keep the scene, since instances of it could already exist.
+            if (scene == nullptr)
+                scene = rtcNewScene(raytracer.device);
+            else if (geometry != RTC_INVALID_GEOMETRY_ID)
+                rtcDetachGeometry(scene, geometry);
+
+            rtcSetSceneFlags(scene, build_options.get_scene_flags());
+            rtcSetSceneBuildQuality(scene, build_quality);
 
-            scene = raytracer.scene;
             pointer = &hair_style;
 
+            built_vertices.clear();
+            refit_count = 0;
+
             hair_diffuse  = hair_style.get_default_color();
             hair_exponent = 50.0f;
 
             rtcCommitGeometry(hair_geometry);
-            geometry = rtcAttachGeometry(raytracer.scene, hair_geometry);
+            geometry = rtcAttachGeometry(scene, hair_geometry);
             rtcReleaseGeometry(hair_geometry);
+
+            commit(raytracer);
+        }
+
+        bool HairStyle::update(const vkhr::HairStyle& hair_style,
+                               const vkhr::Raytracer& raytracer) {
+            if (scene == nullptr || hair_style.get_vertex_count() != position_thickness.size()) {
+                load(hair_style, raytracer);
+                return false;
+            }
+
+            const auto vertices = hair_style.get_vertices();
+            const auto tangents = hair_style.get_tangents();
+
+            // First update: the style is moving, so remember where it was built.
+            if (built_vertices.empty()) {
+                built_vertices.resize(position_thickness.size());
+                for (std::size_t i { 0 }; i < position_thickness.size(); ++i)
+                    built_vertices[i] = glm::vec3 { position_thickness[i] };
+
+                const auto indices = hair_style.get_indices();
+                double segment_length_sum { 0.0 };
+                for (std::size_t i { 0 }; i + 1 < indices.size(); i += 2)
+                    segment_length_sum += glm::distance(built_vertices[indices[i]],
+                                                        built_vertices[indices[i + 1]]);
+                if (indices.size() >= 2)
+                    mean_segment_length = static_cast<float>(segment_length_sum / (indices.size() / 2));
+
+                rtcSetSceneFlags(scene, static_cast<RTCSceneFlags>(rtcGetSceneFlags(scene) |
+                                                               RTC_SCENE_FLAG_DYNAMIC));
+            }
+
+            double displacement_sum { 0.0 };
+
+            #pragma omp parallel for reduction(+:displacement_sum)
+            for (int i = 0; i < static_cast<int>(position_thickness.size()); ++i) {
+                position_thickness[i] = glm::vec4 { vertices[i], position_thickness[i].w };
+                displacement_sum += glm::distance(vertices[i], built_vertices[i]);
+            }
+
+            auto mean_displacement = displacement_sum / std::max<std::size_t>(position_thickness.size(), 1);
+
+            auto hair_geometry = rtcGetGeometry(scene, geometry);
+
+            rtcUpdateGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX, 0);
+
+            // The tangents are regenerated with the vertices, maybe reallocated.
+            rtcSetSharedGeometryBuffer(hair_geometry, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, RTC_FORMAT_FLOAT3,
+                                       tangents.data(),
+                                       0, sizeof(tangents[0]),
+                                       tangents.size());
+
+            bool refit { mean_displacement <= refit_threshold * mean_segment_length };
+
+            if (refit) {
+                rtcSetGeometryBuildQuality(hair_geometry, RTC_BUILD_QUALITY_REFIT);
+                ++refit_count;
+            } else {
+                rtcSetGeometryBuildQuality(hair_geometry, build_quality);
+                for (std::size_t i { 0 }; i < position_thickness.size(); ++i)
+                    built_vertices[i] = glm::vec3 { position_thickness[i] };
+                refit_count = 0;
+            }
+
+            rtcCommitGeometry(hair_geometry);
+            commit(raytracer);
+
+            return refit;
+        }
+
+        void HairStyle::commit(const vkhr::Raytracer& raytracer) {
+            auto memory_before = raytracer.get_memory_usage();
+            auto build_begin = std::chrono::steady_clock::now();
+
+            rtcCommitScene(scene);
+
+            auto build_end = std::chrono::steady_clock::now();
+
+            build_time = std::chrono::duration<float, std::milli>(build_end - build_begin).count();
+
+            // Net change, i.e. a rebuild frees the previous BVH's memory too.
+            memory_usage += static_cast<std::ptrdiff_t>(raytracer.get_memory_usage())
+                          - static_cast<std::ptrdiff_t>(memory_before);
+        }
+
+        void HairStyle::occlusion_filter(const RTCFilterFunctionNArguments* arguments) {
+            auto occlusion_context = reinterpret_cast<const OcclusionContext*>(arguments->context);
+            if (occlusion_context->transmittance == nullptr)
+                return; // i.e. the first hit occludes the ray.
+
+            auto segment_opacity = static_cast<const float*>(arguments->geometryUserPtr);
+
+            // Transmittance is a product, so the order Embree finds hits in
+            // doesn't matter. Rejecting the hit makes Embree carry on with it.
+            for (unsigned i { 0 }; i < arguments->N; ++i) {
+                if (arguments->valid[i] != -1)
+                    continue;
+
+                auto  ray_id   = RTCRayN_id(arguments->ray, arguments->N, i);
+                auto  segment  = RTCHitN_primID(arguments->hit, arguments->N, i);
+                auto  instance = RTCHitN_instID(arguments->hit, arguments->N, i, 0);
+                auto& transmittance = occlusion_context->transmittance[ray_id];
+
+                if (transmittance.add_hit(glm::uvec2 { instance, segment }))
+                    transmittance.value *= 1.0f - segment_opacity[segment];
+
+                if (transmittance.value > MinimumTransmittance)
+                    arguments->valid[i] = 0;
+            }
+        }
+
+        float HairStyle::get_build_time() const {
+            return build_time;
+        }
+
+        std::size_t HairStyle::get_memory_usage() const {
+            return static_cast<std::size_t>(std::max<std::ptrdiff_t>(memory_usage, 0));
+        }
+
+        std::size_t HairStyle::get_segment_count() const {
+            return segment_count;
+        }
+
+        void HairStyle::set_refit_threshold(float refit_threshold) {
+            this->refit_threshold = refit_threshold;
+        }
+
+        float HairStyle::get_refit_threshold() const {
+            return refit_threshold;
+        }
+
+        std::size_t HairStyle::get_refit_count() const {
+            return refit_count;
+        }
+
+        HairStyle::~HairStyle() noexcept {
+            if (scene != nullptr)
+                rtcReleaseScene(scene);
+        }
+
+        HairStyle::HairStyle(HairStyle&& hair_style) noexcept {
+            swap(*this, hair_style);
+        }
+
+        HairStyle& HairStyle::operator=(HairStyle&& hair_style) noexcept {
+            swap(*this, hair_style);
+            return *this;
+        }
+
+        void swap(HairStyle& lhs, HairStyle& rhs) {
+            using std::swap;
+            swap(lhs.geometry, rhs.geometry);
+            swap(lhs.pointer, rhs.pointer);
+            swap(lhs.scene, rhs.scene);
+            swap(lhs.hair_diffuse, rhs.hair_diffuse);
+            swap(lhs.hair_exponent, rhs.hair_exponent);
+            swap(lhs.position_thickness, rhs.position_thickness);
+            swap(lhs.refit_threshold, rhs.refit_threshold);
+            swap(lhs.refit_count, rhs.refit_count);
+            swap(lhs.built_vertices, rhs.built_vertices);
+            swap(lhs.mean_segment_length, rhs.mean_segment_length);
+            swap(lhs.curve_indices, rhs.curve_indices);
+            swap(lhs.segment_count, rhs.segment_count);
+            swap(lhs.build_quality, rhs.build_quality);
+            swap(lhs.segment_opacity, rhs.segment_opacity);
+            swap(lhs.build_time, rhs.build_time);
+            swap(lhs.memory_usage, rhs.memory_usage);
         }
 
         glm::vec3 HairStyle::shade(const Ray& surface_intersection,
                                    const LightSource& light_source,
                                    const Camera& projection_camera) {
+            return shade(surface_intersection, light_source, projection_camera, glm::mat4 { 1.0f });
+        }
+
+        glm::vec3 HairStyle::shade(const Ray& surface_intersection,
+                                   const LightSource& light_source,
+                                   const Camera& projection_camera,
+                                   const glm::mat4& model_matrix) {
             auto surface_position = surface_intersection.get_intersection_point();
 
-            auto strand_direction = get_tangent(surface_intersection);
+            glm::vec3 strand_direction { glm::mat3 { model_matrix } * glm::vec3 { get_tangent(surface_intersection) } };
+            strand_direction = glm::normalize(strand_direction);
             auto light_normal = glm::normalize(light_source.get_spotlight_origin() - surface_position);
             auto eye_normal = glm::normalize(surface_position - projection_camera.get_position());
 
@@ -79,6 +311,10 @@ namespace vkhr {
             return geometry;
         }
 
+        RTCScene HairStyle::get_scene() const {
+            return scene;
+        }
+
         const vkhr::HairStyle* HairStyle::get_pointer() const {
             return pointer;
         }
@@ -107,9 +343,14 @@ namespace vkhr {
             return diffuse_colors + specular_colors;
         }
 
+    #ifndef VKHR_HEADLESS
         void HairStyle::update_parameters(const vkhr::vulkan::HairStyle& hair_style) {
             hair_diffuse  = hair_style.parameters.hair_color;
             hair_exponent = hair_style.parameters.hair_shininess;
+            if (pointer != nullptr && !pointer->has_transparency())
+                std::fill(segment_opacity.begin(), segment_opacity.end(),
+                          hair_style.parameters.hair_opacity);
         }
+    #endif
     }
 }
\ No newline at end of file
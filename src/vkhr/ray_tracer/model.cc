@@ -2,6 +2,8 @@
 
 #include <vkhr/ray_tracer.hh>
 
+#include <cstddef>
+
 namespace vkhr {
     namespace embree {
         Model::Model(const vkhr::Model& model, const vkhr::Raytracer& raytracer) {
@@ -9,34 +11,118 @@ namespace vkhr {
         }
 
         void Model::load(const vkhr::Model& model, const vkhr::Raytracer& raytracer) {
+            const auto& vertices = model.get_vertices();
+            const auto& elements = model.get_elements();
+
             auto model_geometry = rtcNewGeometry(raytracer.device, RTC_GEOMETRY_TYPE_TRIANGLE);
 
-            // Upload geometry here.
+            // Straight from the model's own arrays, i.e. without any copies.
+            // Embree reads 16 bytes for each position, which is fine since
+            // the normal comes right after it, even for the last vertex.
+            rtcSetSharedGeometryBuffer(model_geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3,
+                                       vertices.data(),
+                                       offsetof(vkhr::Model::Vertex, position),
+                                       sizeof(vertices[0]),
+                                       vertices.size());
+
+            rtcSetGeometryVertexAttributeCount(model_geometry, 1);
+
+            rtcSetSharedGeometryBuffer(model_geometry, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, RTC_FORMAT_FLOAT3,
+                                       vertices.data(),
+                                       offsetof(vkhr::Model::Vertex, normal),
+                                       sizeof(vertices[0]),
+                                       vertices.size());
+
+            rtcSetSharedGeometryBuffer(model_geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3,
+                                       elements.data(),
+                                       0, sizeof(elements[0]) * 3,
+                                       elements.size() / 3);
+
+            rtcSetGeometryBuildQuality(model_geometry, raytracer.get_build_options().quality);
+
+            if (scene == nullptr)
+                scene = rtcNewScene(raytracer.device);
+            else if (geometry != RTC_INVALID_GEOMETRY_ID)
+                rtcDetachGeometry(scene, geometry);
+
+            rtcSetSceneFlags(scene, raytracer.get_build_options().get_scene_flags());
+            rtcSetSceneBuildQuality(scene, raytracer.get_build_options().quality);
 
-            scene = raytracer.scene;
+            pointer = &model;
 
             rtcCommitGeometry(model_geometry);
-            geometry = rtcAttachGeometry(raytracer.scene, model_geometry);
+            geometry = rtcAttachGeometry(scene, model_geometry);
             rtcReleaseGeometry(model_geometry);
+
+            rtcCommitScene(scene);
+        }
+
+        Model::~Model() noexcept {
+            if (scene != nullptr)
+                rtcReleaseScene(scene);
+        }
+
+        Model::Model(Model&& model) noexcept {
+            swap(*this, model);
+        }
+
+        Model& Model::operator=(Model&& model) noexcept {
+            swap(*this, model);
+            return *this;
+        }
+
+        void swap(Model& lhs, Model& rhs) {
+            using std::swap;
+            swap(lhs.scene, rhs.scene);
+            swap(lhs.pointer, rhs.pointer);
+            swap(lhs.geometry, rhs.geometry);
         }
 
         glm::vec3 Model::shade(const Ray& surface_intersection,
                                const LightSource& light_source,
                                const Camera& projection_camera) {
-            return glm::vec3 { 1.0f };
+            return shade(surface_intersection, light_source, projection_camera, glm::mat3 { 1.0f });
+        }
+
+        glm::vec3 Model::shade(const Ray& surface_intersection,
+                               const LightSource& light_source,
+                               const Camera&,
+                               const glm::mat3& normal_matrix) {
+            auto surface_position = surface_intersection.get_intersection_point();
+
+            auto surface_normal = glm::normalize(normal_matrix * get_normal(surface_intersection));
+            auto light_normal = glm::normalize(light_source.get_spotlight_origin() - surface_position);
+
+            return lambertian(glm::vec3 { 1.0f }, surface_normal, light_normal);
+        }
+
+        glm::vec3 Model::get_normal(const Ray& position) const {
+            glm::vec3 normal;
+            auto uv = position.get_uv();
+            rtcInterpolate0(rtcGetGeometry(scene, geometry),
+                            position.get_primitive_id(),
+                            uv.x, uv.y,
+                            RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE,
+                            0, &normal.x, 3);
+            return normal;
         }
 
         unsigned Model::get_geometry() const {
             return geometry;
         }
 
-        glm::vec3 Model::blinn_phong(const glm::vec3& diffuse,
-                                     const glm::vec3& specular,
-                                     float shininess,
-                                     const glm::vec3& normal,
-                                     const glm::vec3& light,
-                                     const glm::vec3& eye) {
-            return glm::vec3 { 1.0f };
+        RTCScene Model::get_scene() const {
+            return scene;
+        }
+
+        const vkhr::Model* Model::get_pointer() const {
+            return pointer;
+        }
+
+        glm::vec3 Model::lambertian(const glm::vec3& diffuse,
+                                    const glm::vec3& normal,
+                                    const glm::vec3& light) {
+            return diffuse * glm::max(glm::dot(normal, light), 0.0f);
         }
     }
 }
@@ -1,8 +1,11 @@
 #include <vkhr/ray_tracer/ray.hh>
 
+#include <algorithm>
+
 namespace vkhr {
-    Ray::Ray(const glm::vec3& origin, const glm::vec3& direction, float tnear_plane) {
+    Ray::Ray(const glm::vec3& origin, const glm::vec3& direction, float tnear_plane, float tfar_plane) {
         ray_hit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+        ray_hit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 
         ray_hit.ray.org_x = origin.x;
         ray_hit.ray.org_y = origin.y;
@@ -13,7 +16,9 @@ namespace vkhr {
         ray_hit.ray.dir_z = direction.z;
 
         ray_hit.ray.tnear = tnear_plane;
-        ray_hit.ray.tfar  = std::numeric_limits<float>::infinity();
+        ray_hit.ray.tfar  = tfar_plane;
+
+        ray_hit.ray.mask  = 0xFFFFFFFF;
     }
 
     RTCRay& Ray::get_ray() {
@@ -24,6 +29,22 @@ namespace vkhr {
         return ray_hit.hit;
     }
 
+    bool Transmittance::add_hit(const glm::uvec2& hit) {
+        auto recent_hit_count = std::min(hit_count, RecentHits);
+        for (unsigned i { 0 }; i < recent_hit_count; ++i) {
+            if (recent_hits[i] == hit)
+                return false;
+        }
+
+        recent_hits[hit_count++ % RecentHits] = hit;
+
+        return true;
+    }
+
+    void Ray::set_id(unsigned id) {
+        ray_hit.ray.id = id;
+    }
+
     glm::vec3 Ray::get_origin() const {
         return { ray_hit.ray.org_x,
                  ray_hit.ray.org_y,
@@ -78,6 +99,10 @@ namespace vkhr {
         return ray_hit.hit.geomID;
     }
 
+    unsigned Ray::get_instance_id() const {
+        return ray_hit.hit.instID[0];
+    }
+
     bool Ray::hit_geometry(unsigned  id) const {
         return ray_hit.hit.geomID == id;
     }
@@ -109,4 +134,67 @@ namespace vkhr {
             return false;
         }
     }
+
+    void Ray::intersect_packets(std::vector<Ray>& rays, RTCScene& scene, RTCIntersectContext& context) {
+        for (std::size_t first { 0 }; first < rays.size(); first += PacketSize) {
+            std::size_t packet_size { std::min(PacketSize, rays.size() - first) };
+
+            alignas(32) int valid[PacketSize];
+            alignas(32) RTCRayHit8 packet;
+
+            for (std::size_t i { 0 }; i < PacketSize; ++i) {
+                valid[i] = i < packet_size ? -1 : 0;
+                if (i >= packet_size)
+                    continue;
+
+                const auto& ray = rays[first + i].ray_hit.ray;
+
+                packet.ray.org_x[i] = ray.org_x;
+                packet.ray.org_y[i] = ray.org_y;
+                packet.ray.org_z[i] = ray.org_z;
+                packet.ray.tnear[i] = ray.tnear;
+
+                packet.ray.dir_x[i] = ray.dir_x;
+                packet.ray.dir_y[i] = ray.dir_y;
+                packet.ray.dir_z[i] = ray.dir_z;
+                packet.ray.time[i]  = ray.time;
+
+                packet.ray.tfar[i]  = ray.tfar;
+                packet.ray.mask[i]  = ray.mask;
+                packet.ray.id[i]    = ray.id;
+                packet.ray.flags[i] = ray.flags;
+
+                packet.hit.geomID[i]    = RTC_INVALID_GEOMETRY_ID;
+                packet.hit.instID[0][i] = RTC_INVALID_GEOMETRY_ID;
+            }
+
+            rtcIntersect8(valid, scene, &context, &packet);
+
+            for (std::size_t i { 0 }; i < packet_size; ++i) {
+                auto& ray_hit = rays[first + i].ray_hit;
+
+                ray_hit.ray.tfar = packet.ray.tfar[i];
+
+                ray_hit.hit.Ng_x = packet.hit.Ng_x[i];
+                ray_hit.hit.Ng_y = packet.hit.Ng_y[i];
+                ray_hit.hit.Ng_z = packet.hit.Ng_z[i];
+
+                ray_hit.hit.u = packet.hit.u[i];
+                ray_hit.hit.v = packet.hit.v[i];
+
+                ray_hit.hit.primID    = packet.hit.primID[i];
+                ray_hit.hit.geomID    = packet.hit.geomID[i];
+                ray_hit.hit.instID[0] = packet.hit.instID[0][i];
+            }
+        }
+    }
+
+    void Ray::occluded_by_stream(std::vector<Ray>& rays, RTCScene& scene, RTCIntersectContext& context) {
+        if (rays.empty())
+            return;
+        // Ray is just a RTCRayHit, which starts with the RTCRay, so we can
+        // pass it to Embree as an array of rays, strided by our own size.
+        rtcOccluded1M(scene, &context, &rays[0].ray_hit.ray,
+                      static_cast<unsigned>(rays.size()), sizeof(Ray));
+    }
 }
\ No newline at end of file
@@ -0,0 +1,336 @@
+#include <vkhr/ray_tracer/sampler.hh>
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vkhr {
+    Sampler::Sampler(std::uint32_t seed) : seed { seed } {  }
+
+    void Sampler::set_seed(std::uint32_t seed) {
+        this->seed = seed;
+    }
+
+    std::uint32_t Sampler::get_seed() const {
+        return seed;
+    }
+
+    std::unique_ptr<Sampler> Sampler::create(Type type, std::uint32_t seed) {
+        switch (type) {
+        case Type::Random:
+            return std::make_unique<RandomSampler>(seed);
+        case Type::CorrelatedMultiJittered:
+            return std::make_unique<CmjSampler>(seed);
+        case Type::BlueNoise:
+            return std::make_unique<BlueNoiseSampler>(seed);
+        case Type::Sobol:
+        default:
+            return std::make_unique<SobolSampler>(seed);
+        }
+    }
+
+    std::uint32_t Sampler::hash(std::uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352d;
+        x ^= x >> 15;
+        x *= 0x846ca68b;
+        x ^= x >> 16;
+        return x;
+    }
+
+    std::uint32_t Sampler::hash(std::uint32_t a, std::uint32_t b, std::uint32_t c) {
+        return hash(a ^ hash(b ^ hash(c)));
+    }
+
+    float Sampler::to_float(std::uint32_t bits) {
+        return (bits >> 8) * (1.0f / 16777216.0f); // 24 bits, < 1.
+    }
+
+    glm::vec3 Sampler::uniform_sphere(const glm::vec2& sample) {
+        float z = 1.0f - 2.0f * sample.x;
+        float r = std::sqrt(std::max(1.0f - z * z, 0.0f));
+        float phi = glm::two_pi<float>() * sample.y;
+        return { r * std::cos(phi), r * std::sin(phi), z };
+    }
+
+    glm::vec3 Sampler::cosine_hemisphere(const glm::vec2& sample, const glm::vec3& normal) {
+        // "Building an Orthonormal Basis, Revisited" by Duff et al.
+        float sign = std::copysign(1.0f, normal.z);
+        float a = -1.0f / (sign + normal.z);
+        float b = normal.x * normal.y * a;
+
+        glm::vec3 tangent   { 1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+        glm::vec3 bitangent { b, sign + normal.y * normal.y * a, -normal.y };
+
+        float r = std::sqrt(sample.x);
+        float phi = glm::two_pi<float>() * sample.y;
+
+        return r * std::cos(phi) * tangent   +
+               r * std::sin(phi) * bitangent +
+               std::sqrt(std::max(1.0f - sample.x, 0.0f)) * normal;
+    }
+
+    glm::vec2 RandomSampler::get_2d(const glm::uvec2& pixel, std::uint32_t sample_index, std::uint32_t dimension) const {
+        std::uint32_t state = hash(hash(seed, pixel.x, pixel.y), sample_index, dimension);
+        return { to_float(state), to_float(hash(state)) };
+    }
+
+    Sampler::Type RandomSampler::get_type() const {
+        return Type::Random;
+    }
+
+    glm::vec2 CmjSampler::get_2d(const glm::uvec2& pixel, std::uint32_t sample_index, std::uint32_t dimension) const {
+        const std::uint32_t pattern_samples { PatternSize * PatternSize };
+        std::uint32_t pattern { sample_index / pattern_samples };
+        unsigned permutation = hash(hash(seed, pixel.x, pixel.y), dimension, pattern);
+        // Shuffled, otherwise the first samples all end up in the same row.
+        int s = permute(sample_index % pattern_samples, pattern_samples, permutation * 0x51633e2d);
+        return cmj(s, PatternSize, PatternSize, permutation);
+    }
+
+    Sampler::Type CmjSampler::get_type() const {
+        return Type::CorrelatedMultiJittered;
+    }
+
+    float CmjSampler::rand_float(unsigned i, unsigned p) {
+        i ^= p;
+        i ^= i >> 17;
+        i ^= i >> 10;
+        i *= 0xb36534e5;
+        i ^= i >> 12;
+        i ^= i >> 21;
+        i *= 0x93fc4795;
+        i ^= 0xdf6e307f;
+        i ^= i >> 17;
+        i *= 1 | p >> 18;
+        return i * (1.0f / 4294967808.0f);
+    }
+
+    unsigned CmjSampler::permute(unsigned i, unsigned l, unsigned p) {
+        unsigned w = l - 1;
+
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+
+        do {
+            i ^= p;
+            i *= 0xe170893d;
+            i ^= p >> 16;
+            i ^= (i & w) >> 4;
+            i ^= p >> 8;
+            i *= 0x0929eb3f;
+            i ^= p >> 23;
+            i ^= (i & w) >> 1;
+            i *= 1 | p >> 27;
+            i *= 0x6935fa69;
+            i ^= (i & w) >> 11;
+            i *= 0x74dcb303;
+            i ^= (i & w) >> 2;
+            i *= 0x9e501cc3;
+            i ^= (i & w) >> 2;
+            i *= 0xc860a3df;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= l);
+
+        return (i + p) % l;
+    }
+
+    glm::vec2 CmjSampler::cmj(int s, int m, int n, int p) {
+        int sx = permute(s % m, m, p * 0xa511e9b3),
+            sy = permute(s / m, n, p * 0x63d83595);
+
+        float jx = rand_float(s, p * 0xa399d265),
+              jy = rand_float(s, p * 0x711ad6a5);
+
+        glm::vec2 r = {
+            (s % m + (sy + jx) / n) / m,
+            (s / m + (sx + jy) / m) / n
+        };
+
+        return r;
+    }
+
+    static std::uint32_t reverse_bits(std::uint32_t x) {
+        x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+        x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+        x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+        x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    static std::uint32_t laine_karras_permutation(std::uint32_t x, std::uint32_t seed) {
+        x += seed;
+        x ^= x * 0x6c50b47c;
+        x ^= x * 0xb82f1e52;
+        x ^= x * 0xc7afe638;
+        x ^= x * 0x8d22f6e6;
+        return x;
+    }
+
+    std::uint32_t SobolSampler::sobol(std::uint32_t index, std::uint32_t dimension) {
+        if (dimension == 0)
+            return reverse_bits(index); // i.e. van der Corput.
+
+        // The second dimension has all direction numbers m_k = 1.
+        std::uint32_t result { 0 }, v { 1u << 31 };
+        for (; index != 0; index >>= 1, v ^= v >> 1)
+            if (index & 1) result ^= v;
+        return result;
+    }
+
+    std::uint32_t SobolSampler::nested_uniform_scramble(std::uint32_t x, std::uint32_t seed) {
+        return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+    }
+
+    glm::vec2 SobolSampler::get_2d(const glm::uvec2& pixel, std::uint32_t sample_index, std::uint32_t dimension) const {
+        std::uint32_t dimension_seed = hash(hash(seed, pixel.x, pixel.y), dimension, 0);
+        std::uint32_t index = nested_uniform_scramble(sample_index, dimension_seed);
+        return {
+            to_float(nested_uniform_scramble(sobol(index, 0), hash(dimension_seed ^ 0xa511e9b3))),
+            to_float(nested_uniform_scramble(sobol(index, 1), hash(dimension_seed ^ 0x63d83595)))
+        };
+    }
+
+    Sampler::Type SobolSampler::get_type() const {
+        return Type::Sobol;
+    }
+
+    glm::vec2 BlueNoiseSampler::get_2d(const glm::uvec2& pixel, std::uint32_t sample_index, std::uint32_t dimension) const {
+        std::uint32_t dimension_seed = hash(seed, dimension, 0);
+        std::uint32_t index = SobolSampler::nested_uniform_scramble(sample_index, dimension_seed);
+
+        glm::vec2 sample {
+            to_float(SobolSampler::nested_uniform_scramble(SobolSampler::sobol(index, 0), hash(dimension_seed ^ 0xa511e9b3))),
+            to_float(SobolSampler::nested_uniform_scramble(SobolSampler::sobol(index, 1), hash(dimension_seed ^ 0x63d83595)))
+        };
+
+        const auto& mask = get_mask();
+
+        // Shift the mask differently in each dimension, so they're decorrelated.
+        auto shifted_mask = [&](std::uint32_t shift) {
+            std::uint32_t x { (pixel.x + shift)         % MaskSize },
+                          y { (pixel.y + (shift >> 16)) % MaskSize };
+            return mask[x + y * MaskSize];
+        };
+
+        glm::vec2 offset {
+            shifted_mask(hash(dimension_seed ^ 0xa399d265)),
+            shifted_mask(hash(dimension_seed ^ 0x711ad6a5))
+        };
+
+        sample += offset;
+
+        return sample - glm::floor(sample);
+    }
+
+    Sampler::Type BlueNoiseSampler::get_type() const {
+        return Type::BlueNoise;
+    }
+
+    const std::vector<float>& BlueNoiseSampler::get_mask() {
+        static const std::vector<float> mask { void_and_cluster(MaskSize, 1.5f) };
+        return mask;
+    }
+
+    // "The void-and-cluster method for dither array generation" by Ulichney.
+    std::vector<float> BlueNoiseSampler::void_and_cluster(int size, float sigma) {
+        const int pixels { size * size };
+
+        std::vector<float> gaussian(pixels);
+        for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x) {
+            float dx = std::min(x, size - x),
+                  dy = std::min(y, size - y);
+            gaussian[x + y * size] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+        }
+
+        std::vector<std::uint8_t> pattern(pixels, 0);
+        std::vector<float> energy(pixels, 0.0f);
+
+        auto splat = [&](std::vector<float>& energy, int pixel, float sign) {
+            int px = pixel % size, py = pixel / size;
+            for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x) {
+                int dx = (x - px + size) % size,
+                    dy = (y - py + size) % size;
+                energy[x + y * size] += sign * gaussian[dx + dy * size];
+            }
+        };
+
+        auto find = [&](const std::vector<std::uint8_t>& pattern, const std::vector<float>& energy, std::uint8_t value, bool tightest) {
+            int found { -1 };
+            for (int pixel = 0; pixel < pixels; ++pixel) {
+                if (pattern[pixel] != value) continue;
+                if (found == -1 || ( tightest && energy[pixel] > energy[found])
+                                || (!tightest && energy[pixel] < energy[found]))
+                    found = pixel;
+            }
+            return found;
+        };
+
+        // Start with some random points, and move them from the tightest
+        // clusters to the largest voids, until they stop moving around.
+        int points { 0 };
+        for (int i = 0; points < pixels / 10; ++i) {
+            int pixel = hash(i) % pixels;
+            if (pattern[pixel]) continue;
+            pattern[pixel] = 1;
+            splat(energy, pixel, +1.0f);
+            ++points;
+        }
+
+        for (int iteration = 0; iteration < pixels; ++iteration) {
+            int cluster = find(pattern, energy, 1, true);
+            pattern[cluster] = 0;
+            splat(energy, cluster, -1.0f);
+
+            int largest_void = find(pattern, energy, 0, false);
+            pattern[largest_void] = 1;
+            splat(energy, largest_void, +1.0f);
+
+            if (largest_void == cluster)
+                break;
+        }
+
+        std::vector<int> ranks(pixels);
+
+        // The initial points are ranked by removing the tightest clusters,
+        // and the others by filling the largest voids, until it's all full.
+        auto cluster_pattern = pattern;
+        auto cluster_energy  = energy;
+        for (int rank = points - 1; rank >= 0; --rank) {
+            int cluster = find(cluster_pattern, cluster_energy, 1, true);
+            cluster_pattern[cluster] = 0;
+            splat(cluster_energy, cluster, -1.0f);
+            ranks[cluster] = rank;
+        }
+
+        for (int rank = points; rank < pixels; ++rank) {
+            int largest_void = find(pattern, energy, 0, false);
+            pattern[largest_void] = 1;
+            splat(energy, largest_void, +1.0f);
+            ranks[largest_void] = rank;
+        }
+
+        std::vector<float> mask(pixels);
+        for (int pixel = 0; pixel < pixels; ++pixel)
+            mask[pixel] = (ranks[pixel] + 0.5f) / pixels;
+        return mask;
+    }
+
+    SampleSequence::SampleSequence(const Sampler& sampler, const glm::uvec2& pixel, std::uint32_t sample_index)
+                                  : sampler { &sampler }, pixel { pixel }, sample_index { sample_index } {  }
+
+    glm::vec2 SampleSequence::next_2d() {
+        return sampler->get_2d(pixel, sample_index, dimension++);
+    }
+
+    float SampleSequence::next_1d() {
+        return next_2d().x;
+    }
+}
@@ -6,8 +6,20 @@ using json = nlohmann::json;
 #include <fstream>
 
 #include <stdexcept>
+#include <exception>
+#include <unordered_set>
 
 namespace vkhr {
+    // Bump this whenever the processing in load_style changes.
+    static const std::string style_parameters { "lod=64,thickness=0.042,v1" };
+
+    // The benchmarks sweep through the strand ratios in steps of 1/64th.
+    static const unsigned style_lod_levels { 64 };
+
+    // Tolerances of the simplified styles, relative to their bounding box.
+    static const std::vector<float> style_simplification_errors { 1.0f / 2048.0f, 1.0f / 1024.0f,
+                                                                  1.0f /  512.0f, 1.0f /  256.0f };
+
     SceneGraph::SceneGraph(const std::string& file_path) {
         load(file_path);
     }
@@ -16,18 +28,28 @@ namespace vkhr {
         destroy_previous_node_caches();
         rebuild_lights_buffer_caches();
         const glm::mat4 identity { 1 };
+        transforms_changed = false;
         traverse(*root, identity); // I
+        if (transforms_changed)
+            ++transform_revision;
+    }
+
+    std::size_t SceneGraph::get_transform_revision() const {
+        return transform_revision;
     }
 
     void SceneGraph::traverse(Node& node, const glm::mat4& parent_matrix) {
-        node.set_model_matrix(node.get_local_transform() * parent_matrix);
+        glm::mat4 model_matrix { node.get_local_transform() * parent_matrix };
 
-        auto& model_matrix = node.get_model_matrix();
+        if (model_matrix != node.get_model_matrix()) {
+            node.set_model_matrix(model_matrix);
+            transforms_changed = true;
+        }
 
         build_node_cache(node);
 
         for (auto& child_node : node.get_children())
-            traverse(*child_node, model_matrix);
+            traverse(*child_node, node.get_model_matrix());
     }
 
     bool SceneGraph::load(const std::string& file_path) {
@@ -55,6 +77,10 @@ namespace vkhr {
         if (light_sources.size() >= 16) // Maximum count
             return set_error_state(Error::ReadingLight);
 
+        guide_count = parser.value("guides", 0u);
+
+        load_assets(parser); // add_style/model will find them.
+
         int i = 0;
         if (auto nodes = parser.find("nodes"); nodes != parser.end()) {
             this->nodes.reserve(nodes->size());
@@ -177,6 +203,86 @@ namespace vkhr {
         return true;
     }
 
+    void SceneGraph::load_assets(nlohmann::json& parser) {
+        std::vector<std::string> style_paths, model_paths;
+        std::unordered_set<std::string> unique_paths;
+
+        // Keep the scene order, so the result doesn't depend on timing.
+        if (auto nodes = parser.find("nodes"); nodes != parser.end()) {
+            for (auto& node : *nodes) {
+                if (auto styles = node.find("styles"); styles != node.end()) {
+                    for (std::string style_path : *styles) {
+                        auto path = scene_path + style_path;
+                        if (hair_styles.find(path) == hair_styles.end() &&
+                            style_aliases.find(path) == style_aliases.end() && unique_paths.insert(path).second)
+                            style_paths.push_back(path);
+                    }
+                }
+
+                if (auto models = node.find("models"); models != node.end()) {
+                    for (std::string model_path : *models) {
+                        auto path = scene_path + model_path;
+                        if (this->models.find(path) == this->models.end() && unique_paths.insert(path).second)
+                            model_paths.push_back(path);
+                    }
+                }
+            }
+        }
+
+        std::vector<std::string> style_keys(style_paths.size());
+
+        // Need the content hashes first to find duplicates.
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(style_paths.size()); ++i)
+            style_keys[i] = asset_cache.get_key(style_paths[i], style_parameters);
+
+        std::vector<std::string> unique_style_paths, unique_style_keys;
+
+        for (std::size_t i { 0 }; i < style_paths.size(); ++i) {
+            const auto& style_key = style_keys[i];
+            if (auto style = style_contents.find(style_key); style != style_contents.end()) {
+                style_aliases[style_paths[i]] = style->second;
+            } else {
+                if (!style_key.empty()) style_contents[style_key] = style_paths[i];
+                unique_style_paths.push_back(style_paths[i]);
+                unique_style_keys.push_back(style_key);
+            }
+        }
+
+        style_paths = std::move(unique_style_paths);
+        style_keys  = std::move(unique_style_keys);
+
+        std::vector<HairStyle> styles(style_paths.size());
+        std::vector<Model> models(model_paths.size());
+
+        const int asset_count = static_cast<int>(style_paths.size() + model_paths.size());
+
+        // Can't throw out of OpenMP regions, so rethrow after joining.
+        std::vector<std::exception_ptr> errors(asset_count);
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < asset_count; ++i) {
+            try {
+                if (i < static_cast<int>(styles.size())) {
+                    styles[i] = load_style(style_paths[i], style_keys[i]);
+                } else {
+                    auto model = i - styles.size();
+                    models[model] = load_model(model_paths[model]);
+                }
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+
+        for (auto& error : errors)
+            if (error) std::rethrow_exception(error);
+
+        for (std::size_t i { 0 }; i < styles.size(); ++i)
+            hair_styles[style_paths[i]] = std::move(styles[i]);
+        for (std::size_t i { 0 }; i < models.size(); ++i)
+            this->models[model_paths[i]] = std::move(models[i]);
+    }
+
     void SceneGraph::link_nodes(nlohmann::json& parser) {
         if (auto nodes = parser.find("nodes"); nodes != parser.end()) {
             std::size_t node_id { 0 };
@@ -222,24 +328,23 @@ namespace vkhr {
     HairStyle& SceneGraph::add_style(const std::string& asset_path) {
         auto path = scene_path + asset_path;
 
+        if (auto alias = style_aliases.find(path); alias != style_aliases.end())
+            path = alias->second;
+
         if (hair_styles.find(path) != hair_styles.end())
             return hair_styles[path];
 
-        hair_styles[path] = HairStyle { path };
+        auto cache_key = asset_cache.get_key(path, style_parameters);
 
-        // If you get this exception, it most likely means you haven't cloned using Git LFS.
-        if (!hair_styles[path]) throw std::runtime_error { "Couldn't find: " + path + "!" };
+        // Same contents as a style we've already loaded.
+        if (auto style = style_contents.find(cache_key); style != style_contents.end()) {
+            style_aliases[path] = style->second;
+            return hair_styles[style->second];
+        }
 
-        hair_styles[path].shuffle();
+        hair_styles[path] = load_style(path, cache_key);
 
-        if (!hair_styles[path].has_tangents())
-            hair_styles[path].generate_tangents();
-        if (!hair_styles[path].has_thickness())
-            hair_styles[path].generate_thickness(0.042f);
-        if (!hair_styles[path].has_indices())
-            hair_styles[path].generate_indices();
-        if (!hair_styles[path].has_bounding_box())
-            hair_styles[path].generate_bounding_box();
+        if (!cache_key.empty()) style_contents[cache_key] = path;
 
         return hair_styles[path];
     }
@@ -250,18 +355,105 @@ namespace vkhr {
         if (models.find(path) != models.end())
             return models[path];
 
-        models[path] = Model { path };
+        models[path] = load_model(path);
+
+        return models[path];
+    }
+
+    HairStyle SceneGraph::load_style(const std::string& path, const std::string& cache_key) const {
+        HairStyle hair_style;
+
+        // Skips everything below if we've already done it once.
+        if (asset_cache.load(cache_key, hair_style)) {
+            hair_style.generate_lod_chain(style_lod_levels);
+            simplify_style(hair_style, cache_key);
+            load_guide_strands(hair_style, cache_key);
+            return hair_style;
+        }
+
+        // Not mapped: build_lod_chain() reorders (and so copies) it all.
+        // Only the cached style above is already in the LOD chain order.
+        hair_style = HairStyle { path };
+
+        // If you get this exception, it most likely means you haven't cloned using Git LFS.
+        if (!hair_style) throw std::runtime_error { "Couldn't find: " + path + "!" };
+
+        hair_style.build_lod_chain(style_lod_levels);
+
+        if (!hair_style.has_tangents())
+            hair_style.generate_tangents();
+        if (!hair_style.has_thickness())
+            hair_style.generate_thickness(0.042f);
+        if (!hair_style.has_indices())
+            hair_style.generate_indices();
+        if (!hair_style.has_bounding_box())
+            hair_style.generate_bounding_box();
+
+        if (asset_cache.save(cache_key, hair_style))
+            hair_style.set_cache_key(cache_key);
+
+        simplify_style(hair_style, cache_key);
+        load_guide_strands(hair_style, cache_key);
+
+        return hair_style;
+    }
+
+    void SceneGraph::simplify_style(HairStyle& hair_style, const std::string& cache_key) const {
+        const float radius { hair_style.get_bounding_box().radius };
+
+        std::vector<HairStyle::SimplifiedStrands> simplified_lods;
+
+        for (auto relative_error : style_simplification_errors) {
+            std::string simplified_key { cache_key };
+            if (!simplified_key.empty()) simplified_key += "-simplified-" + std::to_string(relative_error);
+
+            HairStyle::SimplifiedStrands simplified_strands;
+
+            if (!asset_cache.load(simplified_key, simplified_strands) ||
+                simplified_strands.segment_offsets.size() != hair_style.get_strand_count() + 1) {
+                simplified_strands = hair_style.simplify(relative_error * radius);
+                asset_cache.save(simplified_key, simplified_strands);
+            }
+
+            simplified_lods.push_back(std::move(simplified_strands));
+        }
+
+        hair_style.set_simplified_lods(std::move(simplified_lods));
+    }
+
+    void SceneGraph::load_guide_strands(HairStyle& hair_style, const std::string& cache_key) const {
+        if (guide_count == 0) return;
+
+        std::string guide_key { cache_key };
+        if (!guide_key.empty()) guide_key += "-guides-" + std::to_string(guide_count);
+
+        HairStyle::GuideStrands guide_strands;
+
+        // k-means is slow, so it's done here with the rest of the loading.
+        if (!asset_cache.load(guide_key, guide_strands) ||
+            guide_strands.guides.size() != hair_style.get_strand_count()) {
+            guide_strands = hair_style.create_guide_strands(guide_count);
+            asset_cache.save(guide_key, guide_strands);
+        }
+
+        hair_style.set_guide_strands(std::move(guide_strands));
+    }
+
+    Model SceneGraph::load_model(const std::string& path) const {
+        Model model { path };
 
         // Same thing here, this is likely the failure of not having Git LFS installed.
-        if (!models[path]) throw std::runtime_error { "Couldn't find: " + path + "!" };
+        if (!model) throw std::runtime_error { "Couldn't find: " + path + "!" };
 
-        return models[path];
+        return model;
     }
 
     void SceneGraph::clear() {
         destroy_previous_node_caches();
         models.clear();
         hair_styles.clear();
+        style_aliases.clear();
+        style_contents.clear();
         nodes.clear();
         nodes_by_name.clear();
         light_sources.clear();
@@ -281,6 +473,16 @@ namespace vkhr {
     }
 
     bool SceneGraph::remove(std::unordered_map<std::string, HairStyle>::iterator hair_style) {
+        auto forget = [&](std::unordered_map<std::string, std::string>& paths) {
+            for (auto path = paths.begin(); path != paths.end();) {
+                if (path->second == hair_style->first) path = paths.erase(path);
+                else ++path;
+            }
+        };
+
+        forget(style_aliases);
+        forget(style_contents);
+
         return hair_styles.erase(hair_style) != hair_styles.end();
     }
 
@@ -325,6 +527,10 @@ namespace vkhr {
         return camera;
     }
 
+    unsigned SceneGraph::get_guide_count() const {
+        return guide_count;
+    }
+
     Camera& SceneGraph::get_new_camera() const {
         return camera;
     }
@@ -70,6 +70,10 @@ namespace vkhr {
         return field_of_view;
     }
 
+    float Camera::get_pixel_size(float distance) const {
+        return 2.0f * distance * std::tan(field_of_view / 2.0f) / height;
+    }
+
     const glm::vec3& Camera::get_position() const {
         return position;
     }
@@ -102,6 +106,7 @@ namespace vkhr {
         return up_direction;
     }
 
+#ifndef VKHR_HEADLESS
     void Camera::control(InputMap& input_map, const float delta_time, bool imgui_focused) {
         if (input_map.just_released("grab") ||
             input_map.just_released("pan")) {
@@ -130,6 +135,7 @@ namespace vkhr {
             input_map.reset_scrolling_offset();
         }
     }
+#endif
 
     void Camera::pan_relative_to(const glm::vec2& cursor) {
         translate(get_left_direction() * cursor.x +
@@ -1,16 +1,178 @@
 #include <vkhr/scene_graph/hair_style.hh>
 
 #include <random>
+#include <bitset>
 #include <cstring>
 #include <algorithm>
 #include <fstream>
 #include <numeric>
+#include <iterator>
+#include <type_traits>
+#include <limits>
+#include <cmath>
 
 namespace vkhr {
-    HairStyle::HairStyle(const std::string& file_path) {
+    // Below are the encoders for the compressed .hairz format.
+
+    static std::uint32_t zigzag_encode(std::int32_t value) {
+        return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+    }
+
+    static std::int32_t zigzag_decode(std::uint32_t value) {
+        return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+    }
+
+    static void write_varint(std::vector<unsigned char>& stream, std::uint32_t value) {
+        while (value >= 0x80) {
+            stream.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+
+        stream.push_back(static_cast<unsigned char>(value));
+    }
+
+    static bool read_varint(const unsigned char*& stream, const unsigned char* end, std::uint32_t& value) {
+        value = 0;
+        for (unsigned shift { 0 }; shift < 32; shift += 7) {
+            if (stream == end) return false;
+            unsigned char byte { *stream++ };
+            value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+
+        return false;
+    }
+
+    static glm::ivec3 quantize_position(const glm::vec3& position, const glm::vec3& origin, const glm::vec3& scale) {
+        glm::vec3 grid { glm::round((position - origin) * scale) };
+        return glm::clamp(glm::ivec3 { grid }, glm::ivec3 { 0 }, glm::ivec3 { 65535 });
+    }
+
+    // See "A Survey of Efficient Representations for Independent Unit Vectors".
+    static glm::i16vec2 octahedral_encode(const glm::vec3& direction) {
+        glm::vec3 n { direction / (std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z)) };
+        glm::vec2 octahedron { n.x, n.y };
+
+        if (n.z < 0.0f) {
+            octahedron = glm::vec2 {
+                (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? +1.0f : -1.0f),
+                (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? +1.0f : -1.0f)
+            };
+        }
+
+        return glm::i16vec2 { glm::round(glm::clamp(octahedron, -1.0f, +1.0f) * 32767.0f) };
+    }
+
+    static glm::vec3 octahedral_decode(const glm::i16vec2& encoded) {
+        glm::vec2 octahedron { glm::vec2 { encoded } / 32767.0f };
+        glm::vec3 n { octahedron.x, octahedron.y, 1.0f - std::abs(octahedron.x) - std::abs(octahedron.y) };
+
+        if (n.z < 0.0f) {
+            float x { n.x };
+            n.x = (1.0f - std::abs(n.y)) * (x   >= 0.0f ? +1.0f : -1.0f);
+            n.y = (1.0f - std::abs(x))   * (n.y >= 0.0f ? +1.0f : -1.0f);
+        }
+
+        return glm::normalize(n);
+    }
+
+    static unsigned char quantize_unorm8(float value) {
+        return static_cast<unsigned char>(std::lround(glm::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+
+    // Spreads the lower 10 bits so there are two zero bits between each.
+    static std::uint32_t expand_bits(std::uint32_t value) {
+        value = (value * 0x00010001u) & 0xff0000ffu;
+        value = (value * 0x00000101u) & 0x0f00f00fu;
+        value = (value * 0x00000011u) & 0xc30c30c3u;
+        value = (value * 0x00000005u) & 0x49249249u;
+        return value;
+    }
+
+    // Interleaves the bits of a position in [0, 1]³ quantized to 1024³.
+    static std::uint32_t morton_code(const glm::vec3& position) {
+        glm::uvec3 grid { glm::clamp(position * 1024.0f, 0.0f, 1023.0f) };
+        return expand_bits(grid.x) << 2 | expand_bits(grid.y) << 1 | expand_bits(grid.z);
+    }
+
+    static float segment_distance(const glm::vec3& point, const glm::vec3& begin, const glm::vec3& end) {
+        glm::vec3 segment { end - begin };
+        float length_squared { glm::dot(segment, segment) };
+        if (length_squared == 0.0f) return glm::length(point - begin);
+        float t { glm::clamp(glm::dot(point - begin, segment) / length_squared, 0.0f, 1.0f) };
+        return glm::length(point - (begin + t * segment));
+    }
+
+    // Marks the vertices of a polyline that Douglas-Peucker keeps, i.e. so
+    // that no removed vertex is further than max_error from the new one.
+    static void simplify_polyline(const glm::vec3* vertices, std::size_t count, float max_error,
+                                  unsigned char* keep) {
+        std::fill(keep, keep + count, 0);
+
+        keep[0] = keep[count - 1] = 1;
+
+        std::vector<std::pair<std::size_t, std::size_t>> stack;
+        if (count > 2) stack.emplace_back(0, count - 1);
+
+        while (!stack.empty()) {
+            auto [first, last] = stack.back();
+            stack.pop_back();
+
+            float furthest_distance { 0.0f };
+            std::size_t furthest { first };
+
+            for (std::size_t vertex { first + 1 }; vertex < last; ++vertex) {
+                float distance { segment_distance(vertices[vertex], vertices[first], vertices[last]) };
+                if (distance > furthest_distance) {
+                    furthest_distance = distance;
+                    furthest = vertex;
+                }
+            }
+
+            if (furthest_distance <= max_error)
+                continue;
+
+            keep[furthest] = 1;
+
+            if (furthest - first > 1) stack.emplace_back(first, furthest);
+            if (last - furthest > 1) stack.emplace_back(furthest, last);
+        }
+    }
+
+    // Position at t in [0, 1] along the polyline, evenly spaced by vertex.
+    static glm::vec3 sample_polyline(const glm::vec3* vertices, std::size_t count, float t) {
+        float position { t * (count - 1) };
+        std::size_t vertex { static_cast<std::size_t>(position) };
+        if (vertex + 1 >= count) return vertices[count - 1];
+        return glm::mix(vertices[vertex], vertices[vertex + 1], position - vertex);
+    }
+
+    static void resample_polyline(const glm::vec3* vertices, std::size_t count, unsigned samples,
+                                  glm::vec3* resampled) {
+        for (unsigned sample { 0 }; sample < samples; ++sample) {
+            float t { static_cast<float>(sample) / (samples - 1) };
+            resampled[sample] = sample_polyline(vertices, count, t);
+        }
+    }
+
+    // Squared distance between two resampled strands, which stops summing
+    // once it's above the limit, since it can't be the closest one then.
+    static float shape_distance(const glm::vec3* lhs, const glm::vec3* rhs, unsigned samples, float limit) {
+        float distance { 0.0f };
+        for (unsigned sample { 0 }; sample < samples && distance < limit; ++sample) {
+            glm::vec3 difference { lhs[sample] - rhs[sample] };
+            distance += glm::dot(difference, difference);
+        }
+
+        return distance;
+    }
+
+    HairStyle::HairStyle(const std::string& file_path, const bool memory_mapped) {
         std::random_device random;
         seed = random();
-        load(file_path);
+        if (memory_mapped)
+            map(file_path);
+        else load(file_path);
     }
 
     HairStyle::operator bool() const {
@@ -26,9 +188,13 @@ namespace vkhr {
 
         if (!file) return set_error_state(Error::OpeningFile);
 
+        release_mapping(); // From any previous map() call.
+
         if (!file.read(reinterpret_cast<char*>(&file_header), sizeof(FileHeader)))
             return set_error_state(Error::ReadingFileHeader);
 
+        if (compressed_signature()) return read_compressed(file);
+
         if (!valid_signature()) return set_error_state(Error::InvalidSignature);
 
         if (!read_segments(file)) return set_error_state(Error::ReadingSegments);
@@ -41,9 +207,94 @@ namespace vkhr {
 
         if (!format_is_valid()) return set_error_state(Error::InvalidFormat);
 
+        generate_strand_offsets();
+
+        return set_error_state(Error::None);
+    }
+
+    bool HairStyle::map(const std::string& file_path) {
+        release_mapping(); // Unmaps the previous file.
+
+        auto mapping = std::make_shared<MappedFile>(file_path);
+
+        if (!*mapping) return set_error_state(Error::MappingFile);
+
+        if (mapping->get_size() < sizeof(FileHeader))
+            return set_error_state(Error::ReadingFileHeader);
+
+        std::memcpy(&file_header, mapping->get_data(), sizeof(FileHeader));
+
+        // Needs to be decoded anyway.
+        if (compressed_signature())
+            return load(file_path);
+
+        if (!valid_signature()) return set_error_state(Error::InvalidSignature);
+
+        mapped_file = mapping;
+
+        std::size_t offset { sizeof(FileHeader) };
+
+        auto count_if = [](bool has_field, std::size_t count) -> std::size_t {
+            return has_field ? count : 0;
+        };
+
+        if (!map_field(offset, count_if(file_header.field.has_segments, file_header.strand_count), segments, mapped_segments))
+            return set_error_state(Error::ReadingSegments);
+        if (!map_field(offset, count_if(file_header.field.has_vertices, file_header.vertex_count), vertices, mapped_vertices))
+            return set_error_state(Error::ReadingVertices);
+        if (!map_field(offset, count_if(file_header.field.has_thickness, file_header.vertex_count), thickness, mapped_thickness))
+            return set_error_state(Error::ReadingThickness);
+        if (!map_field(offset, count_if(file_header.field.has_transparency, file_header.vertex_count), transparency, mapped_transparency))
+            return set_error_state(Error::ReadingTransparency);
+        if (!map_field(offset, count_if(file_header.field.has_color, file_header.vertex_count), color, mapped_color))
+            return set_error_state(Error::ReadingColor);
+        if (!map_field(offset, count_if(file_header.field.has_tangents, file_header.vertex_count), tangents, mapped_tangents))
+            return set_error_state(Error::ReadingTangents);
+        if (!map_field(offset, count_if(file_header.field.has_indices, get_segment_count() * 2), indices, mapped_indices))
+            return set_error_state(Error::ReadingIndices);
+
+        if (!format_is_valid()) return set_error_state(Error::InvalidFormat);
+
+        generate_strand_offsets();
+
         return set_error_state(Error::None);
     }
 
+    bool HairStyle::is_mapped() const {
+        return mapped_file != nullptr;
+    }
+
+    void HairStyle::materialize() {
+        if (!is_mapped())
+            return;
+
+        auto copy_field = [](auto& mapped_field, auto& field) {
+            if (!mapped_field.empty())
+                field.assign(mapped_field.begin(), mapped_field.end());
+        };
+
+        copy_field(mapped_segments, segments);
+        copy_field(mapped_vertices, vertices);
+        copy_field(mapped_thickness, thickness);
+        copy_field(mapped_transparency, transparency);
+        copy_field(mapped_color, color);
+        copy_field(mapped_tangents, tangents);
+        copy_field(mapped_indices, indices);
+
+        release_mapping();
+    }
+
+    void HairStyle::release_mapping() {
+        mapped_segments = {};
+        mapped_vertices = {};
+        mapped_thickness = {};
+        mapped_transparency = {};
+        mapped_color = {};
+        mapped_tangents = {};
+        mapped_indices = {};
+        mapped_file.reset();
+    }
+
     bool HairStyle::save(const std::string& file_path) const {
         complete_header(); // Fill in remaining header fields.
 
@@ -69,9 +320,254 @@ namespace vkhr {
         return set_error_state(Error::None);
     }
 
+    bool HairStyle::save_compressed(const std::string& file_path) const {
+        complete_header(); // Fill in remaining header fields.
+
+        if (!format_is_valid()) return set_error_state(Error::InvalidFormat);
+
+        const auto segments = get_segments();
+        const auto vertices = get_vertices();
+        const auto thickness = get_thickness();
+        const auto transparency = get_transparency();
+        const auto color = get_color();
+        const auto tangents = get_tangents();
+
+        FileHeader header { file_header };
+
+        header.signature[3] = 'Z';
+        header.field.has_indices = false; // Generated on load.
+
+        // Quantization grid needs to enclose every single vertex (if any).
+        glm::vec3 grid_min { 0.0f }, grid_max { 0.0f };
+        if (!vertices.empty()) grid_min = grid_max = vertices[0];
+
+        if (has_bounding_box()) {
+            grid_min = glm::min(grid_min, glm::vec3 { header.bounding_box_min[0], header.bounding_box_min[1], header.bounding_box_min[2] });
+            grid_max = glm::max(grid_max, glm::vec3 { header.bounding_box_max[0], header.bounding_box_max[1], header.bounding_box_max[2] });
+        }
+
+        for (const auto& position : vertices) {
+            grid_min = glm::min(grid_min, position);
+            grid_max = glm::max(grid_max, position);
+        }
+
+        std::memcpy(&header.bounding_box_min[0], &grid_min[0], sizeof(grid_min));
+        std::memcpy(&header.bounding_box_max[0], &grid_max[0], sizeof(grid_max));
+
+        header.field.has_bounding_box = true;
+
+        glm::vec3 grid_extent { grid_max - grid_min };
+        glm::vec3 grid_scale { 0.0f };
+
+        for (int axis { 0 }; axis < 3; ++axis)
+            if (grid_extent[axis] > 0.0f)
+                grid_scale[axis] = 65535.0f / grid_extent[axis];
+
+        std::vector<unsigned char> positions;
+        positions.reserve(vertices.size() * 6);
+
+        glm::ivec3 previous_root { 0 }, previous { 0 };
+
+        std::size_t vertex { 0 };
+        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
+            unsigned segment_count { get_default_segment_count() };
+
+            if (has_segments()) segment_count = segments[strand];
+
+            for (std::size_t i { 0 }; i <= segment_count; ++i, ++vertex) {
+                glm::ivec3 quantized { quantize_position(vertices[vertex], grid_min, grid_scale) };
+
+                // Roots are close on the scalp, the rest are along a strand.
+                glm::ivec3 delta { quantized - (i == 0 ? previous_root : previous) };
+
+                for (int axis { 0 }; axis < 3; ++axis)
+                    write_varint(positions, zigzag_encode(delta[axis]));
+
+                if (i == 0) previous_root = quantized;
+                previous = quantized;
+            }
+        }
+
+        float thickness_scale { 0.0f };
+        for (auto strand_thickness : thickness)
+            thickness_scale = std::max(thickness_scale, strand_thickness);
+
+        CompressedHeader compressed_header {
+            CompressedVersion,
+            static_cast<unsigned>(positions.size()),
+            thickness_scale
+        };
+
+        std::ofstream file { file_path, std::ios::binary };
+
+        if (!file) return set_error_state(Error::OpeningFile);
+
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader)) ||
+            !file.write(reinterpret_cast<const char*>(&compressed_header), sizeof(CompressedHeader)))
+            return set_error_state(Error::WritingFileHeader);
+
+        if (header.field.has_segments && !write_field(file, segments))
+            return set_error_state(Error::WritingSegments);
+
+        if (!file.write(reinterpret_cast<const char*>(positions.data()), positions.size()))
+            return set_error_state(Error::WritingVertices);
+
+        if (header.field.has_thickness) {
+            std::vector<unsigned char> quantized(thickness.size());
+            for (std::size_t i { 0 }; i < thickness.size(); ++i)
+                quantized[i] = quantize_unorm8(thickness_scale > 0.0f ? thickness[i] / thickness_scale : 0.0f);
+            if (!write_field(file, Span<unsigned char> { quantized }))
+                return set_error_state(Error::WritingThickness);
+        }
+
+        if (header.field.has_transparency) {
+            std::vector<unsigned char> quantized(transparency.size());
+            for (std::size_t i { 0 }; i < transparency.size(); ++i)
+                quantized[i] = quantize_unorm8(transparency[i]);
+            if (!write_field(file, Span<unsigned char> { quantized }))
+                return set_error_state(Error::WritingTransparency);
+        }
+
+        if (header.field.has_color) {
+            std::vector<glm::u8vec3> quantized(color.size());
+            for (std::size_t i { 0 }; i < color.size(); ++i)
+                quantized[i] = glm::u8vec3 { quantize_unorm8(color[i].r),
+                                             quantize_unorm8(color[i].g),
+                                             quantize_unorm8(color[i].b) };
+            if (!write_field(file, Span<glm::u8vec3> { quantized }))
+                return set_error_state(Error::WritingColor);
+        }
+
+        if (header.field.has_tangents) {
+            std::vector<glm::i16vec2> encoded(tangents.size());
+            for (std::size_t i { 0 }; i < tangents.size(); ++i)
+                encoded[i] = octahedral_encode(tangents[i]);
+            if (!write_field(file, Span<glm::i16vec2> { encoded }))
+                return set_error_state(Error::WritingTangents);
+        }
+
+        return set_error_state(Error::None);
+    }
+
+    bool HairStyle::read_compressed(std::ifstream& file) {
+        CompressedHeader compressed_header;
+
+        if (!file.read(reinterpret_cast<char*>(&compressed_header), sizeof(CompressedHeader)))
+            return set_error_state(Error::ReadingFileHeader);
+
+        if (compressed_header.version != CompressedVersion)
+            return set_error_state(Error::InvalidSignature);
+
+        const std::size_t vertex_count { file_header.vertex_count };
+
+        // Don't trust the header, it must fit in the file before we allocate.
+        const auto data_begin = file.tellg();
+        file.seekg(0, std::ios::end);
+        const std::uint64_t data_size { static_cast<std::uint64_t>(file.tellg() - data_begin) };
+        file.seekg(data_begin);
+
+        std::uint64_t expected_size { compressed_header.position_bytes };
+        if (file_header.field.has_segments)     expected_size += std::uint64_t { file_header.strand_count } * sizeof(unsigned short);
+        if (file_header.field.has_thickness)    expected_size += std::uint64_t { vertex_count } * sizeof(unsigned char);
+        if (file_header.field.has_transparency) expected_size += std::uint64_t { vertex_count } * sizeof(unsigned char);
+        if (file_header.field.has_color)        expected_size += std::uint64_t { vertex_count } * sizeof(glm::u8vec3);
+        if (file_header.field.has_tangents)     expected_size += std::uint64_t { vertex_count } * sizeof(glm::i16vec2);
+
+        // Every position is three varints, which are 1 to 5 bytes each.
+        if (expected_size > data_size ||
+            compressed_header.position_bytes < std::uint64_t { vertex_count } * 3 ||
+            compressed_header.position_bytes > std::uint64_t { vertex_count } * 15)
+            return set_error_state(Error::InvalidFormat);
+
+        file_header.signature[3] = 'R'; // We store it decompressed.
+
+        if (!read_segments(file)) return set_error_state(Error::ReadingSegments);
+
+        std::vector<unsigned char> positions(compressed_header.position_bytes);
+        if (!read_field(file, positions)) return set_error_state(Error::ReadingVertices);
+
+        glm::vec3 grid_min { file_header.bounding_box_min[0], file_header.bounding_box_min[1], file_header.bounding_box_min[2] };
+        glm::vec3 grid_max { file_header.bounding_box_max[0], file_header.bounding_box_max[1], file_header.bounding_box_max[2] };
+
+        glm::vec3 grid_step { (grid_max - grid_min) / 65535.0f };
+
+        vertices.resize(vertex_count);
+
+        const unsigned char* stream { positions.data() };
+        const unsigned char* stream_end { stream + positions.size() };
+
+        glm::ivec3 previous_root { 0 }, previous { 0 };
+
+        std::size_t vertex { 0 };
+        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
+            unsigned segment_count { get_default_segment_count() };
+
+            if (has_segments()) segment_count = segments[strand];
+
+            for (std::size_t i { 0 }; i <= segment_count; ++i, ++vertex) {
+                if (vertex >= vertex_count) return set_error_state(Error::ReadingVertices);
+
+                glm::ivec3 quantized { i == 0 ? previous_root : previous };
+
+                for (int axis { 0 }; axis < 3; ++axis) {
+                    std::uint32_t delta;
+                    if (!read_varint(stream, stream_end, delta))
+                        return set_error_state(Error::ReadingVertices);
+                    quantized[axis] += zigzag_decode(delta);
+                }
+
+                vertices[vertex] = grid_min + glm::vec3 { quantized } * grid_step;
+
+                if (i == 0) previous_root = quantized;
+                previous = quantized;
+            }
+        }
+
+        if (vertex != vertex_count) return set_error_state(Error::ReadingVertices);
+
+        if (file_header.field.has_thickness) {
+            std::vector<unsigned char> quantized(vertex_count);
+            if (!read_field(file, quantized)) return set_error_state(Error::ReadingThickness);
+            thickness.resize(vertex_count);
+            for (std::size_t i { 0 }; i < vertex_count; ++i)
+                thickness[i] = quantized[i] / 255.0f * compressed_header.thickness_scale;
+        }
+
+        if (file_header.field.has_transparency) {
+            std::vector<unsigned char> quantized(vertex_count);
+            if (!read_field(file, quantized)) return set_error_state(Error::ReadingTransparency);
+            transparency.resize(vertex_count);
+            for (std::size_t i { 0 }; i < vertex_count; ++i)
+                transparency[i] = quantized[i] / 255.0f;
+        }
+
+        if (file_header.field.has_color) {
+            std::vector<glm::u8vec3> quantized(vertex_count);
+            if (!read_field(file, quantized)) return set_error_state(Error::ReadingColor);
+            color.resize(vertex_count);
+            for (std::size_t i { 0 }; i < vertex_count; ++i)
+                color[i] = glm::vec3 { quantized[i] } / 255.0f;
+        }
+
+        if (file_header.field.has_tangents) {
+            std::vector<glm::i16vec2> encoded(vertex_count);
+            if (!read_field(file, encoded)) return set_error_state(Error::ReadingTangents);
+            tangents.resize(vertex_count);
+            for (std::size_t i { 0 }; i < vertex_count; ++i)
+                tangents[i] = octahedral_decode(encoded[i]);
+        }
+
+        generate_strand_offsets();
+        generate_indices();
+
+        if (!format_is_valid()) return set_error_state(Error::InvalidFormat);
+
+        return set_error_state(Error::None);
+    }
+
     unsigned HairStyle::get_strand_count() const {
-        if (segments.size() != 0) {
-            return static_cast<unsigned>(segments.size());
+        if (get_segments().size() != 0) {
+            return static_cast<unsigned>(get_segments().size());
         } else {
             // Use the manually defined one.
             return file_header.strand_count;
@@ -87,16 +583,16 @@ namespace vkhr {
     }
 
     unsigned HairStyle::get_vertex_count() const {
-        return static_cast<unsigned>(vertices.size());
+        return static_cast<unsigned>(get_vertices().size());
     }
 
-    bool HairStyle::has_segments() const { return segments.size(); }
-    bool HairStyle::has_vertices() const { return vertices.size(); }
-    bool HairStyle::has_thickness() const { return thickness.size(); }
-    bool HairStyle::has_transparency() const { return transparency.size(); }
-    bool HairStyle::has_color() const { return color.size(); }
-    bool HairStyle::has_tangents() const { return tangents.size(); }
-    bool HairStyle::has_indices() const { return indices.size(); }
+    bool HairStyle::has_segments() const { return get_segments().size(); }
+    bool HairStyle::has_vertices() const { return get_vertices().size(); }
+    bool HairStyle::has_thickness() const { return get_thickness().size(); }
+    bool HairStyle::has_transparency() const { return get_transparency().size(); }
+    bool HairStyle::has_color() const { return get_color().size(); }
+    bool HairStyle::has_tangents() const { return get_tangents().size(); }
+    bool HairStyle::has_indices() const { return get_indices().size(); }
 
     // Pre-generated AABB for the hair styles.
     bool HairStyle::has_bounding_box() const {
@@ -145,6 +641,14 @@ namespace vkhr {
         return file_header.information;
     }
 
+    const std::string& HairStyle::get_cache_key() const {
+        return cache_key;
+    }
+
+    void HairStyle::set_cache_key(const std::string& cache_key) {
+        this->cache_key = cache_key;
+    }
+
     void HairStyle::set_information(const std::string& information) {
         const std::size_t info_size { sizeof(file_header.information) };
         std::memset(file_header.information, '\0', info_size); // For consistency.
@@ -152,63 +656,96 @@ namespace vkhr {
         std::strncpy(file_header.information, information.c_str(), copy_size);
     }
 
-    void HairStyle::generate_thickness(float radius) {
-        thickness.clear();
-        thickness.reserve(get_vertex_count());
+    void HairStyle::generate_strand_offsets() {
+        const auto segments = get_segments();
+
+        strand_offsets.resize(get_strand_count() + 1);
+        strand_offsets[0] = 0;
 
         for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
             unsigned segment_count { get_default_segment_count() };
 
             if (has_segments()) segment_count = segments[strand];
 
-            for (std::size_t segment { 0 }; segment < segment_count; ++segment)
-                thickness.push_back(radius);
+            strand_offsets[strand + 1] = strand_offsets[strand] + segment_count + 1;
+        }
+    }
+
+    const std::vector<unsigned>& HairStyle::get_strand_offsets() const {
+        return strand_offsets;
+    }
+
+    bool HairStyle::strand_offsets_valid() const {
+        return strand_offsets.size() == get_strand_count() + 1 &&
+               strand_offsets.back() == get_vertex_count();
+    }
+
+    void HairStyle::generate_thickness(float radius) {
+        if (!strand_offsets_valid()) generate_strand_offsets();
+
+        mapped_thickness = {};
+        thickness.resize(strand_offsets.back());
 
-            thickness.push_back(0);
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int strand = 0; strand < static_cast<int>(get_strand_count()); ++strand) {
+            const std::size_t begin { strand_offsets[strand + 0] },
+                              end   { strand_offsets[strand + 1] };
+
+            std::fill(thickness.begin() + begin, thickness.begin() + end - 1, radius);
+
+            thickness[end - 1] = 0.0f;
         }
     }
 
     void HairStyle::generate_tangents() {
-        tangents.clear();
-        tangents.reserve(get_vertex_count());
+        if (!strand_offsets_valid()) generate_strand_offsets();
 
-        std::size_t vertex { 0 };
+        mapped_tangents = {};
+        tangents.resize(get_vertex_count());
 
-        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
-            unsigned segment_count { get_default_segment_count() };
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int strand = 0; strand < static_cast<int>(get_strand_count()); ++strand) {
+            generate_strand_tangents(strand);
+        }
+    }
 
-            if (has_segments()) segment_count = segments[strand];
+    void HairStyle::generate_strand_tangents(std::size_t strand) {
+        const auto vertices = get_vertices();
 
-            for (std::size_t segment { 0 }; segment < segment_count; ++segment) {
-                const auto& current_vertex { vertices[vertex + 0] };
-                const auto& next_vertex    { vertices[vertex + 1] };
-                const auto tangent { next_vertex - current_vertex };
+        const std::size_t begin { strand_offsets[strand + 0] },
+                          end   { strand_offsets[strand + 1] };
 
-                tangents.push_back(glm::normalize(tangent));
-                ++vertex;
-            }
+        for (std::size_t vertex { begin }; vertex < end - 1; ++vertex) {
+            const auto& current_vertex { vertices[vertex + 0] };
+            const auto& next_vertex    { vertices[vertex + 1] };
+            const auto tangent { next_vertex - current_vertex };
 
-            tangents.push_back(tangents.back()); // Special:
-            ++vertex; // must derive tangents from previous.
+            tangents[vertex] = glm::normalize(tangent);
         }
+
+        // Special: must derive tangents from previous.
+        if (end - begin > 1) tangents[end - 1] = tangents[end - 2];
+        else tangents[end - 1] = glm::vec3 { 0.0f };
     }
 
     void HairStyle::generate_indices() {
-        indices.clear();
-        indices.reserve(get_segment_count() * 2);
+        if (!strand_offsets_valid()) generate_strand_offsets();
 
-        std::size_t vertex { 0 };
-        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
-            unsigned segment_count { get_default_segment_count() };
+        mapped_indices = {};
+        indices.resize(get_segment_count() * 2);
 
-            if (has_segments()) segment_count = this->segments[strand];
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int strand = 0; strand < static_cast<int>(get_strand_count()); ++strand) {
+            const std::size_t begin { strand_offsets[strand + 0] },
+                              end   { strand_offsets[strand + 1] };
 
-            for (std::size_t segment { 0 }; segment < segment_count; ++segment) {
-                indices.push_back(static_cast<unsigned>(vertex++));
-                indices.push_back(static_cast<unsigned>(vertex));
-            }
+            // Each strand before us has one vertex more than segments.
+            std::size_t index { 2 * (begin - strand) };
 
-            ++vertex; // Skips the last one.
+            for (std::size_t vertex { begin }; vertex < end - 1; ++vertex) {
+                indices[index++] = static_cast<unsigned>(vertex + 0);
+                indices[index++] = static_cast<unsigned>(vertex + 1);
+            } // Skips the last one.
         }
     }
 
@@ -216,7 +753,7 @@ namespace vkhr {
         glm::vec3 min_aabb { 0.0f, 0.0f, 0.0f },
                   max_aabb { 0.0f, 0.0f, 0.0f };
 
-        for (const auto& position : vertices) {
+        for (const auto& position : get_vertices()) {
             min_aabb.x = glm::min(position.x, min_aabb.x);
             min_aabb.y = glm::min(position.y, min_aabb.y);
             min_aabb.z = glm::min(position.z, min_aabb.z);
@@ -269,6 +806,9 @@ namespace vkhr {
 
         std::vector<glm::vec3> precise_tangents(width * height * depth);
 
+        const auto vertices = get_vertices();
+        const auto tangents = get_tangents();
+
         for (unsigned int i { 0 }; i < get_vertex_count(); ++i) {
             auto& vertex = vertices[i];
             glm::vec3 voxel { (vertex - volume.bounds.origin) / voxel_size };
@@ -293,7 +833,111 @@ namespace vkhr {
         return volume;
     }
 
-    HairStyle::Volume HairStyle::voxelize_segments(std::size_t width, std::size_t height, std::size_t depth) const {
+    // Walks the voxels from root to tip in "A Fast Voxel Traversal Algorithm
+    // for Ray Tracing", visiting only the ones in [z_begin, z_end). Indices
+    // are stepped as integers, and each voxel is visited at most one time.
+    template<typename F>
+    static void traverse_voxels(const glm::vec3& root, const glm::vec3& tip, const glm::ivec3& resolution,
+                                int z_begin, int z_end, F visit) {
+        glm::ivec3 voxel { glm::clamp(glm::ivec3 { glm::floor(root) }, glm::ivec3 { 0 }, resolution - 1) };
+        glm::ivec3 last  { glm::clamp(glm::ivec3 { glm::floor(tip) },  glm::ivec3 { 0 }, resolution - 1) };
+
+        const glm::vec3 direction { tip - root };
+
+        glm::ivec3 step;
+        glm::vec3 t_max, t_delta;
+
+        for (int axis { 0 }; axis < 3; ++axis) {
+            if (direction[axis] > 0.0f) {
+                step[axis]    = +1;
+                t_delta[axis] = 1.0f / direction[axis];
+                t_max[axis]   = (voxel[axis] + 1.0f - root[axis]) / direction[axis];
+            } else if (direction[axis] < 0.0f) {
+                step[axis]    = -1;
+                t_delta[axis] = -1.0f / direction[axis];
+                t_max[axis]   = (voxel[axis] - root[axis]) / direction[axis];
+            } else {
+                step[axis]    = 0;
+                t_delta[axis] = std::numeric_limits<float>::infinity();
+                t_max[axis]   = std::numeric_limits<float>::infinity();
+            }
+        }
+
+        // Every step moves one voxel closer to the last one along an axis.
+        int steps_left { std::abs(last.x - voxel.x) + std::abs(last.y - voxel.y) + std::abs(last.z - voxel.z) };
+
+        while (true) {
+            if (voxel.z >= z_begin && voxel.z < z_end)
+                visit(voxel);
+            else if ((step.z > 0 && voxel.z >= z_end) || (step.z < 0 && voxel.z < z_begin))
+                break; // We've gone past the slab.
+
+            if (steps_left-- == 0)
+                break;
+
+            int axis { 0 };
+            if (t_max.y < t_max[axis]) axis = 1;
+            if (t_max.z < t_max[axis]) axis = 2;
+
+            // Rounding might pick an axis we're already done with.
+            if (voxel[axis] == last[axis]) {
+                for (axis = 0; axis < 3; ++axis)
+                    if (voxel[axis] != last[axis])
+                        break;
+            }
+
+            voxel[axis] += step[axis];
+            t_max[axis] += t_delta[axis];
+        }
+    }
+
+    // Does the segment overlap the voxel? Voxels are half-open [v, v + 1),
+    // like the floor() in the traversal, and the ones on the edges of the
+    // grid reach out to infinity, since the traversal clamps to the grid.
+    static bool overlaps_voxel(const glm::vec3& root, const glm::vec3& tip,
+                               const glm::ivec3& voxel, const glm::ivec3& resolution) {
+        constexpr double infinity { std::numeric_limits<double>::infinity() };
+
+        double t_enter { 0.0 }, t_exit { 1.0 };
+        bool enter_open { false }, exit_open { false };
+
+        for (int axis { 0 }; axis < 3; ++axis) {
+            double lower { voxel[axis] == 0 ? -infinity : voxel[axis] },
+                   upper { voxel[axis] == resolution[axis] - 1 ? infinity : voxel[axis] + 1.0 };
+
+            double origin { root[axis] }, direction { static_cast<double>(tip[axis]) - origin };
+
+            if (direction == 0.0) {
+                if (origin < lower || origin >= upper)
+                    return false;
+                continue;
+            }
+
+            // Where the segment is in [lower, upper), closed on the lower one.
+            double t_lower { (lower - origin) / direction },
+                   t_upper { (upper - origin) / direction };
+
+            double t_first { direction > 0.0 ? t_lower : t_upper },
+                   t_last  { direction > 0.0 ? t_upper : t_lower };
+            bool first_open { direction < 0.0 },
+                 last_open  { direction > 0.0 };
+
+            if (t_first > t_enter || (t_first == t_enter && first_open)) {
+                t_enter = t_first;
+                enter_open = first_open;
+            }
+
+            if (t_last < t_exit || (t_last == t_exit && last_open)) {
+                t_exit = t_last;
+                exit_open = last_open;
+            }
+        }
+
+        return t_enter < t_exit || (t_enter == t_exit && !enter_open && !exit_open);
+    }
+
+    HairStyle::Volume HairStyle::voxelize_segments(std::size_t width, std::size_t height, std::size_t depth,
+                                                   Voxelization method) const {
         Volume volume {
             {
                 width,
@@ -304,33 +948,30 @@ namespace vkhr {
         };
 
         volume.densities.resize(width * height * depth, 0); // ~ 16MiBs.
-        glm::vec3 voxel_size { volume.bounds.size / volume.resolution };
 
         std::vector<glm::vec3> precise_tangents(width * height * depth);
 
-        for (std::size_t i { 0 }; i < indices.size() - 1; i += 2) {
-            auto root { (vertices[indices[i]]     - volume.bounds.origin) / voxel_size };
-            auto tip  { (vertices[indices[i + 1]] - volume.bounds.origin) / voxel_size };
+        // The volume is split into slabs along z, and each thread owns some
+        // of them. Segments are binned into the slabs they could touch, in
+        // order, so every voxel still sees the same segments in the same
+        // order as a serial loop would, i.e. the results are identical.
+        const std::size_t slab_depth { 8 };
 
-            auto direction { tip - root };
-            float steps { glm::compMax(glm::abs(direction)) };
-            direction /= steps; // [-1, 1]
+        auto slab_segments = bin_segments(volume.resolution, volume.bounds, slab_depth);
 
-            while (steps-- > 0.0f) {
-                auto voxel = glm::min(glm::floor(root), volume.resolution-1.0f);
-                int voxel_index = voxel.x + voxel.y*width + voxel.z*width*height;
-                if (volume.densities[voxel_index] != 255) {
-                    precise_tangents[voxel_index] += tangents[indices[i]];
-                    volume.densities[voxel_index] += 1;
-                }
-
-                root += direction; // Move to the voxel we're going to rasterize.
-            }
+        #pragma omp parallel for schedule(dynamic)
+        for (int slab = 0; slab < static_cast<int>(slab_segments.size()); ++slab) {
+            std::size_t slab_offset { slab * slab_depth * width * height };
+            voxelize_slab(volume.resolution, volume.bounds, slab_segments[slab],
+                          static_cast<int>(slab * slab_depth),
+                          static_cast<int>(slab * slab_depth + slab_depth), method,
+                          volume.densities.data() + slab_offset,
+                          precise_tangents.data() + slab_offset);
         }
 
         volume.tangents.resize(width * height * depth, glm::i8vec4 { 0, 0, 0, 0 });
 
-        #pragma omp parallel for schedule(dynamic)
+        #pragma omp parallel for schedule(static) // Uniform work.
         for (int i = 0; i < volume.densities.size(); ++i) {
             glm::i8vec3 quantized  = precise_tangents[i] / static_cast<float>(volume.densities[i]) * 127.0f;
             volume.tangents[i].x   = quantized.x;
@@ -341,6 +982,634 @@ namespace vkhr {
         return volume;
     }
 
+    HairStyle::BrickVolume HairStyle::voxelize_bricks(std::size_t width, std::size_t height, std::size_t depth,
+                                                      Voxelization method) const {
+        constexpr int brick_size { BrickVolume::BrickSize };
+
+        BrickVolume volume {
+            {
+                width,
+                height,
+                depth
+            },
+            get_bounding_box()
+        };
+
+        volume.brick_grid = (glm::ivec3 { volume.resolution } + brick_size - 1) / brick_size;
+        volume.brick_table.resize(volume.brick_grid.x * volume.brick_grid.y * volume.brick_grid.z,
+                                  BrickVolume::EmptyBrick);
+
+        // Same as voxelize_segments, but a slab is one layer of bricks, and
+        // only its non-empty bricks are kept after it's been rasterized.
+        auto slab_segments = bin_segments(volume.resolution, volume.bounds, brick_size);
+
+        struct BrickLayer {
+            std::vector<int> bricks; // x + y * brick_grid.x
+            std::vector<std::uint64_t> occupancy;
+            std::vector<unsigned char> densities;
+            std::vector<glm::i8vec4>    tangents;
+        };
+
+        std::vector<BrickLayer> brick_layers(slab_segments.size());
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int slab = 0; slab < static_cast<int>(slab_segments.size()); ++slab) {
+            if (slab_segments[slab].empty())
+                continue;
+
+            std::vector<unsigned char> densities(width * height * brick_size, 0);
+            std::vector<glm::vec3> precise_tangents(width * height * brick_size);
+
+            voxelize_slab(volume.resolution, volume.bounds, slab_segments[slab],
+                          slab * brick_size, slab * brick_size + brick_size, method,
+                          densities.data(), precise_tangents.data());
+
+            auto& layer = brick_layers[slab];
+
+            const int slab_depth { std::min(brick_size, static_cast<int>(depth) - slab * brick_size) };
+
+            for (int brick_y = 0; brick_y < volume.brick_grid.y; ++brick_y)
+            for (int brick_x = 0; brick_x < volume.brick_grid.x; ++brick_x) {
+                const int brick_width  { std::min(brick_size, static_cast<int>(width)  - brick_x * brick_size) },
+                          brick_height { std::min(brick_size, static_cast<int>(height) - brick_y * brick_size) };
+
+                auto voxel_index = [&](int x, int y, int z) {
+                    return (brick_x * brick_size + x) + (brick_y * brick_size + y) * width + z * width * height;
+                };
+
+                bool empty { true };
+
+                for (int z = 0; z < slab_depth && empty; ++z)
+                for (int y = 0; y < brick_height && empty; ++y)
+                for (int x = 0; x < brick_width; ++x) {
+                    if (densities[voxel_index(x, y, z)] != 0) {
+                        empty = false;
+                        break;
+                    }
+                }
+
+                if (empty) continue;
+
+                layer.bricks.push_back(brick_x + brick_y * volume.brick_grid.x);
+
+                std::size_t mask_offset { layer.occupancy.size() };
+
+                layer.occupancy.resize(mask_offset + BrickVolume::MaskWords, 0);
+
+                // In bit order, so only the non-empty voxels are appended.
+                for (int z = 0; z < slab_depth; ++z)
+                for (int y = 0; y < brick_height; ++y)
+                for (int x = 0; x < brick_width; ++x) {
+                    auto index = voxel_index(x, y, z);
+                    auto bit = x + y * brick_size + z * brick_size * brick_size;
+
+                    auto density = densities[index];
+
+                    if (density == 0)
+                        continue;
+
+                    layer.occupancy[mask_offset + bit / 64] |= std::uint64_t { 1 } << (bit % 64);
+
+                    glm::i8vec3 quantized = precise_tangents[index] / static_cast<float>(density) * 127.0f;
+                    layer.densities.push_back(density);
+                    layer.tangents.push_back(glm::i8vec4 { quantized, 0 });
+                }
+            }
+        }
+
+        unsigned brick_count { 0 };
+
+        // Assigned in slab order, so they don't depend on thread timings.
+        for (std::size_t slab { 0 }; slab < brick_layers.size(); ++slab) {
+            auto& layer = brick_layers[slab];
+
+            for (auto brick : layer.bricks) {
+                auto table_index = brick + slab * volume.brick_grid.x * volume.brick_grid.y;
+                volume.brick_table[table_index] = brick_count++;
+            }
+
+            volume.occupancy.insert(volume.occupancy.end(), layer.occupancy.begin(), layer.occupancy.end());
+            volume.densities.insert(volume.densities.end(), layer.densities.begin(), layer.densities.end());
+            volume.tangents.insert(volume.tangents.end(), layer.tangents.begin(), layer.tangents.end());
+
+            layer = BrickLayer {  }; // Free.
+        }
+
+        volume.generate_voxel_offsets();
+
+        return volume;
+    }
+
+    std::vector<std::vector<unsigned>> HairStyle::bin_segments(const glm::vec3& resolution, const AABB& bounds,
+                                                              std::size_t slab_depth) const {
+        const auto vertices = get_vertices();
+        const auto indices  = get_indices();
+
+        glm::vec3 voxel_size { bounds.size / resolution };
+
+        const std::size_t slab_count { (static_cast<std::size_t>(resolution.z) + slab_depth - 1) / slab_depth };
+
+        const int segment_count = static_cast<int>(indices.size() / 2);
+
+        std::vector<glm::uvec2> segment_slabs(segment_count);
+
+        #pragma omp parallel for schedule(dynamic, 4096)
+        for (int s = 0; s < segment_count; ++s) {
+            float root { (vertices[indices[2*s + 0]].z - bounds.origin.z) / voxel_size.z };
+            float tip  { (vertices[indices[2*s + 1]].z - bounds.origin.z) / voxel_size.z };
+
+            // Pad by one voxel since the stepping below accumulates error.
+            float first_voxel { glm::clamp(glm::floor(glm::min(root, tip)) - 1.0f, 0.0f, resolution.z - 1.0f) };
+            float last_voxel  { glm::clamp(glm::floor(glm::max(root, tip)) + 1.0f, 0.0f, resolution.z - 1.0f) };
+
+            segment_slabs[s] = glm::uvec2 {
+                static_cast<unsigned>(first_voxel) / slab_depth,
+                static_cast<unsigned>(last_voxel)  / slab_depth
+            };
+        }
+
+        std::vector<std::vector<unsigned>> slab_segments(slab_count);
+
+        for (int s = 0; s < segment_count; ++s)
+            for (unsigned slab { segment_slabs[s].x }; slab <= segment_slabs[s].y; ++slab)
+                slab_segments[slab].push_back(s);
+
+        return slab_segments;
+    }
+
+    void HairStyle::voxelize_slab(const glm::vec3& resolution, const AABB& bounds,
+                                  const std::vector<unsigned>& segments,
+                                  int slab_begin, int slab_end, Voxelization method,
+                                  unsigned char* densities, glm::vec3* precise_tangents) const {
+        const auto vertices = get_vertices();
+        const auto tangents = get_tangents();
+        const auto indices  = get_indices();
+
+        glm::vec3 voxel_size { bounds.size / resolution };
+
+        const std::size_t width  { static_cast<std::size_t>(resolution.x) },
+                          height { static_cast<std::size_t>(resolution.y) };
+
+        // The storage only covers the voxels in [slab_begin, slab_end).
+        auto rasterize = [&](std::size_t i, int x, int y, int z) {
+            std::size_t voxel_index = x + y*width + (z - slab_begin)*width*height;
+            if (densities[voxel_index] != 255) {
+                precise_tangents[voxel_index] += tangents[indices[i]];
+                densities[voxel_index] += 1;
+            }
+        };
+
+        for (auto s : segments) {
+            std::size_t i { 2 * static_cast<std::size_t>(s) };
+
+            auto root { (vertices[indices[i]]     - bounds.origin) / voxel_size };
+            auto tip  { (vertices[indices[i + 1]] - bounds.origin) / voxel_size };
+
+            if (method == Voxelization::Traversal) {
+                traverse_voxels(root, tip, glm::ivec3 { resolution }, slab_begin, slab_end,
+                                [&](const glm::ivec3& voxel) {
+                    rasterize(i, voxel.x, voxel.y, voxel.z);
+                });
+
+                continue;
+            }
+
+            if (method == Voxelization::Reference) {
+                const glm::ivec3 grid { resolution };
+
+                glm::ivec3 first { glm::clamp(glm::ivec3 { glm::floor(glm::min(root, tip)) }, glm::ivec3 { 0 }, grid - 1) };
+                glm::ivec3 last  { glm::clamp(glm::ivec3 { glm::floor(glm::max(root, tip)) }, glm::ivec3 { 0 }, grid - 1) };
+
+                first.z = glm::max(first.z, slab_begin);
+                last.z  = glm::min(last.z,  slab_end - 1);
+
+                // Voxels get their segments in the same order as before, so
+                // the tangent sums are the same as the traversal's as well.
+                for (int z { first.z }; z <= last.z; ++z)
+                for (int y { first.y }; y <= last.y; ++y)
+                for (int x { first.x }; x <= last.x; ++x)
+                    if (overlaps_voxel(root, tip, { x, y, z }, grid))
+                        rasterize(i, x, y, z);
+
+                continue;
+            }
+
+            auto direction { tip - root };
+            float steps { glm::compMax(glm::abs(direction)) };
+            direction /= steps; // [-1, 1]
+
+            while (steps-- > 0.0f) {
+                auto voxel = glm::min(glm::floor(root), resolution-1.0f);
+                if (voxel.z >= slab_begin && voxel.z < slab_end)
+                    rasterize(i, voxel.x, voxel.y, voxel.z);
+
+                root += direction; // Move to the voxel we're going to rasterize.
+            }
+        }
+    }
+
+    HairStyle::DynamicVolume HairStyle::voxelize_dynamic(std::size_t width, std::size_t height, std::size_t depth,
+                                                         Voxelization method) const {
+        constexpr int brick_size { BrickVolume::BrickSize };
+
+        DynamicVolume dynamic_volume;
+
+        dynamic_volume.volume = Volume {
+            {
+                width,
+                height,
+                depth
+            },
+            get_bounding_box()
+        };
+
+        dynamic_volume.method = method;
+
+        auto& volume = dynamic_volume.volume;
+
+        volume.densities.resize(width * height * depth, 0);
+        volume.tangents.resize(width * height * depth, glm::i8vec4 { 0, 0, 0, 0 });
+
+        dynamic_volume.brick_grid = (glm::ivec3 { volume.resolution } + brick_size - 1) / brick_size;
+        dynamic_volume.brick_table.resize(dynamic_volume.brick_grid.x *
+                                          dynamic_volume.brick_grid.y *
+                                          dynamic_volume.brick_grid.z,
+                                          BrickVolume::EmptyBrick);
+
+        const auto vertices = get_vertices();
+        const auto tangents = get_tangents();
+
+        dynamic_volume.voxelized_vertices.assign(vertices.begin(), vertices.end());
+        dynamic_volume.voxelized_tangents.assign(tangents.begin(), tangents.end());
+
+        // Bricks are allocated as they're touched, so this one is serial.
+        for (std::size_t strand { 0 }; strand < get_strand_count(); ++strand) {
+            accumulate_strand(dynamic_volume, strand, vertices.data(), tangents.data(), +1, nullptr);
+        }
+
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < static_cast<int>(volume.densities.size()); ++i) {
+            dynamic_volume.refresh_voxel(i);
+        }
+
+        return dynamic_volume;
+    }
+
+    std::size_t HairStyle::revoxelize(DynamicVolume& dynamic_volume) const {
+        auto& volume = dynamic_volume.volume;
+
+        dynamic_volume.changed_voxels.clear();
+
+        // Strands were added or removed, so the snapshot is no good to us.
+        if (dynamic_volume.voxelized_vertices.size() != get_vertex_count()) {
+            auto density_scale = dynamic_volume.density_scale;
+
+            dynamic_volume = voxelize_dynamic(static_cast<std::size_t>(volume.resolution.x),
+                                              static_cast<std::size_t>(volume.resolution.y),
+                                              static_cast<std::size_t>(volume.resolution.z),
+                                              dynamic_volume.method);
+
+            if (density_scale != 1.0f) dynamic_volume.normalize();
+
+            dynamic_volume.changed_voxels.resize(dynamic_volume.volume.densities.size());
+            std::iota(dynamic_volume.changed_voxels.begin(), dynamic_volume.changed_voxels.end(), 0);
+
+            return get_strand_count();
+        }
+
+        const auto vertices = get_vertices();
+        const auto tangents = get_tangents();
+
+        auto& changed_voxels = dynamic_volume.changed_voxels;
+
+        for (auto strand : dirty_strands) {
+            const std::size_t begin { strand_offsets[strand + 0] },
+                              end   { strand_offsets[strand + 1] };
+
+            accumulate_strand(dynamic_volume, strand,
+                              dynamic_volume.voxelized_vertices.data(),
+                              dynamic_volume.voxelized_tangents.data(),
+                              -1, &changed_voxels);
+
+            accumulate_strand(dynamic_volume, strand, vertices.data(), tangents.data(),
+                              +1, &changed_voxels);
+
+            std::copy(vertices.begin() + begin, vertices.begin() + end, dynamic_volume.voxelized_vertices.begin() + begin);
+            std::copy(tangents.begin() + begin, tangents.begin() + end, dynamic_volume.voxelized_tangents.begin() + begin);
+        }
+
+        std::sort(changed_voxels.begin(), changed_voxels.end());
+        changed_voxels.erase(std::unique(changed_voxels.begin(), changed_voxels.end()),
+                             changed_voxels.end());
+
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < static_cast<int>(changed_voxels.size()); ++i) {
+            dynamic_volume.refresh_voxel(changed_voxels[i]);
+        }
+
+        return dirty_strands.size();
+    }
+
+    void HairStyle::accumulate_strand(DynamicVolume& dynamic_volume, std::size_t strand,
+                                      const glm::vec3* vertices, const glm::vec3* tangents,
+                                      int weight, std::vector<std::size_t>* changed_voxels) const {
+        constexpr int brick_size { BrickVolume::BrickSize };
+        constexpr std::size_t brick_voxels { brick_size * brick_size * brick_size };
+
+        const auto& volume = dynamic_volume.volume;
+        const auto& brick_grid = dynamic_volume.brick_grid;
+
+        const glm::ivec3 grid { volume.resolution };
+        const glm::vec3 voxel_size { volume.bounds.size / volume.resolution };
+
+        auto rasterize = [&](const glm::ivec3& voxel, const glm::vec3& tangent) {
+            glm::ivec3 brick { voxel / brick_size };
+
+            auto& brick_entry = dynamic_volume.brick_table[brick.x + brick.y * brick_grid.x +
+                                                           brick.z * brick_grid.x * brick_grid.y];
+
+            if (brick_entry == BrickVolume::EmptyBrick) {
+                brick_entry = static_cast<unsigned>(dynamic_volume.densities.size() / brick_voxels);
+                dynamic_volume.densities.resize(dynamic_volume.densities.size() + brick_voxels, 0);
+                dynamic_volume.tangents.resize(dynamic_volume.tangents.size() + brick_voxels, glm::ivec3 { 0 });
+            }
+
+            glm::ivec3 local { voxel % brick_size };
+            std::size_t index { brick_entry * brick_voxels + local.x + local.y * brick_size +
+                                                                        local.z * brick_size * brick_size };
+
+            // Same rounding either way, so removing a strand is exact.
+            dynamic_volume.densities[index] += weight;
+            dynamic_volume.tangents[index]  += weight * glm::ivec3 { glm::round(tangent * DynamicVolume::TangentScale) };
+
+            if (changed_voxels)
+                changed_voxels->push_back(voxel.x + voxel.y * grid.x + static_cast<std::size_t>(voxel.z) * grid.x * grid.y);
+        };
+
+        const std::size_t begin { strand_offsets[strand + 0] },
+                          end   { strand_offsets[strand + 1] };
+
+        for (std::size_t vertex { begin }; vertex + 1 < end; ++vertex) {
+            auto root { (vertices[vertex + 0] - volume.bounds.origin) / voxel_size };
+            auto tip  { (vertices[vertex + 1] - volume.bounds.origin) / voxel_size };
+
+            const auto& tangent = tangents[vertex];
+
+            if (dynamic_volume.method == Voxelization::Traversal) {
+                traverse_voxels(root, tip, grid, 0, grid.z, [&](const glm::ivec3& voxel) {
+                    rasterize(voxel, tangent);
+                });
+
+                continue;
+            }
+
+            auto direction { tip - root };
+            float steps { glm::compMax(glm::abs(direction)) };
+            direction /= steps; // [-1, 1]
+
+            while (steps-- > 0.0f) {
+                // Moving strands may leave the volume, clamp them to its side.
+                rasterize(glm::clamp(glm::ivec3 { glm::floor(root) }, glm::ivec3 { 0 }, grid - 1), tangent);
+                root += direction;
+            }
+        }
+    }
+
+    void HairStyle::DynamicVolume::refresh_voxel(std::size_t voxel) {
+        constexpr int brick_size { BrickVolume::BrickSize };
+
+        const std::size_t width  { static_cast<std::size_t>(volume.resolution.x) },
+                          height { static_cast<std::size_t>(volume.resolution.y) };
+
+        glm::ivec3 position {
+            voxel % width,
+            voxel / width % height,
+            voxel / (width * height)
+        };
+
+        glm::ivec3 brick { position / brick_size },
+                   local { position % brick_size };
+
+        auto brick_entry = brick_table[brick.x + brick.y * brick_grid.x +
+                                       brick.z * brick_grid.x * brick_grid.y];
+
+        unsigned count { 0 };
+        glm::ivec3 tangent { 0 };
+
+        if (brick_entry != BrickVolume::EmptyBrick) {
+            std::size_t index { brick_entry * static_cast<std::size_t>(brick_size * brick_size * brick_size) +
+                                local.x + local.y * brick_size + local.z * brick_size * brick_size };
+            count   = densities[index];
+            tangent = tangents[index];
+        }
+
+        volume.densities[voxel] = static_cast<unsigned char>(std::min(count * density_scale, 255.0f));
+
+        if (count == 0) {
+            volume.tangents[voxel] = glm::i8vec4 { 0, 0, 0, 0 };
+            return;
+        }
+
+        glm::i8vec3 quantized = glm::vec3 { tangent } / (count * TangentScale) * 127.0f;
+        volume.tangents[voxel].x = quantized.x;
+        volume.tangents[voxel].y = quantized.y;
+        volume.tangents[voxel].z = quantized.z;
+    }
+
+    void HairStyle::DynamicVolume::normalize() {
+        unsigned densest { 0 };
+        for (auto count : densities)
+            densest = std::max(densest, count);
+
+        if (densest == 0)
+            return; // Nothing to scale, e.g. an empty volume.
+
+        density_scale = 255.0f / densest;
+
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < static_cast<int>(volume.densities.size()); ++i) {
+            refresh_voxel(i);
+        }
+    }
+
+    std::size_t HairStyle::DynamicVolume::get_size() const {
+        return brick_table.size()        * sizeof(brick_table[0])        +
+               densities.size()          * sizeof(densities[0])          +
+               tangents.size()           * sizeof(tangents[0])           +
+               voxelized_vertices.size() * sizeof(voxelized_vertices[0]) +
+               voxelized_tangents.size() * sizeof(voxelized_tangents[0]) +
+               changed_voxels.size()     * sizeof(changed_voxels[0])     +
+               volume.densities.size()   * sizeof(volume.densities[0])   +
+               volume.tangents.size()    * sizeof(volume.tangents[0]);
+    }
+
+    void HairStyle::set_strand_vertices(unsigned strand, Span<glm::vec3> strand_vertices) {
+        if (!strand_offsets_valid()) generate_strand_offsets();
+
+        if (strand >= get_strand_count() ||
+            strand_vertices.size() != strand_offsets[strand + 1] - strand_offsets[strand])
+            return;
+
+        materialize();
+
+        std::copy(strand_vertices.begin(), strand_vertices.end(), vertices.begin() + strand_offsets[strand]);
+
+        if (has_tangents()) generate_strand_tangents(strand);
+
+        mark_strand_dirty(strand);
+    }
+
+    void HairStyle::mark_strand_dirty(unsigned strand) {
+        // The strands changed since we last did this, so start over.
+        if (strand_dirty.size() != get_strand_count()) {
+            strand_dirty.assign(get_strand_count(), false);
+            dirty_strands.clear();
+        }
+
+        if (strand_dirty[strand])
+            return;
+
+        strand_dirty[strand] = true;
+        dirty_strands.push_back(strand);
+    }
+
+    void HairStyle::mark_strands_dirty() {
+        for (unsigned strand { 0 }; strand < get_strand_count(); ++strand)
+            mark_strand_dirty(strand);
+    }
+
+    bool HairStyle::is_strand_dirty(unsigned strand) const {
+        return strand < strand_dirty.size() && strand_dirty[strand];
+    }
+
+    std::size_t HairStyle::get_dirty_strand_count() const {
+        return dirty_strands.size();
+    }
+
+    const std::vector<unsigned>& HairStyle::get_dirty_strands() const {
+        return dirty_strands;
+    }
+
+    void HairStyle::clear_dirty_strands() {
+        for (auto strand : dirty_strands) strand_dirty[strand] = false;
+        dirty_strands.clear();
+    }
+
+    unsigned char HairStyle::BrickVolume::get_density(const glm::ivec3& voxel) const {
+        auto index = find_voxel(voxel);
+        if (index == npos) return 0;
+        return densities[index];
+    }
+
+    glm::i8vec4 HairStyle::BrickVolume::get_tangent(const glm::ivec3& voxel) const {
+        auto index = find_voxel(voxel);
+        if (index == npos) return glm::i8vec4 { 0, 0, 0, 0 };
+        return tangents[index];
+    }
+
+    std::size_t HairStyle::BrickVolume::find_voxel(const glm::ivec3& voxel) const {
+        auto brick = brick_table[get_brick_index(voxel)];
+        if (brick == EmptyBrick) return npos;
+
+        auto bit  = get_voxel_index(voxel);
+        auto mask = &occupancy[brick * MaskWords];
+
+        if (!(mask[bit / 64] & (std::uint64_t { 1 } << (bit % 64))))
+            return npos;
+
+        // The voxel's rank in the brick: how many stored voxels are before.
+        std::size_t index { voxel_offsets[brick] };
+        for (std::size_t word { 0 }; word < bit / 64; ++word)
+            index += std::bitset<64> { mask[word] }.count();
+        index += std::bitset<64> { mask[bit / 64] & ((std::uint64_t { 1 } << (bit % 64)) - 1) }.count();
+
+        return index;
+    }
+
+    std::size_t HairStyle::BrickVolume::generate_voxel_offsets() {
+        voxel_offsets.resize(get_brick_count());
+
+        std::size_t voxel_count { 0 };
+        for (std::size_t brick { 0 }; brick < voxel_offsets.size(); ++brick) {
+            voxel_offsets[brick] = static_cast<unsigned>(voxel_count);
+            for (int word { 0 }; word < MaskWords; ++word)
+                voxel_count += std::bitset<64> { occupancy[brick * MaskWords + word] }.count();
+        }
+
+        return voxel_count;
+    }
+
+    std::size_t HairStyle::BrickVolume::get_brick_index(const glm::ivec3& voxel) const {
+        glm::ivec3 brick { voxel / BrickSize };
+        return brick.x + brick.y * brick_grid.x + brick.z * brick_grid.x * brick_grid.y;
+    }
+
+    std::size_t HairStyle::BrickVolume::get_voxel_index(const glm::ivec3& voxel) const {
+        glm::ivec3 local { voxel % BrickSize };
+        return local.x + local.y * BrickSize + local.z * BrickSize * BrickSize;
+    }
+
+    std::size_t HairStyle::BrickVolume::get_brick_count() const {
+        return occupancy.size() / MaskWords;
+    }
+
+    std::size_t HairStyle::BrickVolume::get_size() const {
+        return brick_table.size()   * sizeof(brick_table[0])   +
+               occupancy.size()     * sizeof(occupancy[0])     +
+               voxel_offsets.size() * sizeof(voxel_offsets[0]) +
+               densities.size()     * sizeof(densities[0])     +
+               tangents.size()      * sizeof(tangents[0]);
+    }
+
+    void HairStyle::BrickVolume::normalize() {
+        // Voxels that aren't stored are zero, so they count for the minimum.
+        std::size_t voxel_count { static_cast<std::size_t>(resolution.x) *
+                                  static_cast<std::size_t>(resolution.y) *
+                                  static_cast<std::size_t>(resolution.z) };
+        bool has_empty_voxels = densities.size() < voxel_count;
+
+        unsigned char data_min { static_cast<unsigned char>(has_empty_voxels ? 0 : 255) }, data_max { 0 };
+        for (std::size_t i { 0 }; i < densities.size(); ++i) {
+            if (densities[i] > data_max) data_max = densities[i];
+            if (densities[i] < data_min) data_min = densities[i];
+        }
+
+        if (data_max == data_min)
+            return; // Nothing to stretch, e.g. an empty volume.
+
+        float scaling { 255.0f / (data_max - data_min) };
+
+        for (std::size_t i { 0 }; i < densities.size(); ++i) {
+            densities[i] -= data_min;
+            densities[i] = densities[i] * scaling;
+        }
+    }
+
+    HairStyle::Volume HairStyle::BrickVolume::to_dense() const {
+        Volume volume {
+            resolution,
+            bounds
+        };
+
+        const int width  { static_cast<int>(resolution.x) },
+                  height { static_cast<int>(resolution.y) },
+                  depth  { static_cast<int>(resolution.z) };
+
+        volume.densities.resize(width * height * depth, 0);
+        volume.tangents.resize(width * height * depth, glm::i8vec4 { 0, 0, 0, 0 });
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int z = 0; z < depth; ++z)
+        for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width;  ++x) {
+            std::size_t index = x + y * width + z * width * height;
+            volume.densities[index] = get_density({ x, y, z });
+            volume.tangents[index]  = get_tangent({ x, y, z });
+        }
+
+        return volume;
+    }
+
     void HairStyle::Volume::normalize() {
         unsigned char data_min { 255 }, data_max { 0 };
         for (std::size_t i { 0 }; i < densities.size(); ++i) {
@@ -348,6 +1617,9 @@ namespace vkhr {
             if (densities[i] < data_min) data_min = densities[i];
         }
 
+        if (data_max == data_min)
+            return; // Nothing to stretch, e.g. an empty volume.
+
         float scaling { 255.0f / (data_max - data_min) };
 
         for (std::size_t i { 0 }; i < densities.size(); ++i) {
@@ -356,6 +1628,24 @@ namespace vkhr {
         }
     }
 
+    std::size_t HairStyle::Volume::get_mip_levels() const {
+        int longest_side { static_cast<int>(glm::compMax(resolution)) };
+        std::size_t mip_levels { 1 };
+        while (longest_side > 1) {
+            longest_side /= 2;
+            ++mip_levels;
+        }
+
+        return mip_levels;
+    }
+
+    unsigned char HairStyle::Volume::average(Span<unsigned char> neighborhood) {
+        unsigned sum = neighborhood.size() / 2; // round to nearest.
+        for (auto density : neighborhood)
+            sum += density;
+        return static_cast<unsigned char>(sum / neighborhood.size());
+    }
+
     bool HairStyle::Volume::save(const std::string& file_path) {
         std::ofstream file { file_path, std::ios::binary };
         if (!file) return false; // Couldn't write to file.
@@ -391,24 +1681,19 @@ namespace vkhr {
         if (has_transparency()) reduced_transparency.reserve(vertex_count);
         if (has_color()) reduced_color.reserve(vertex_count);
 
-        std::vector<std::size_t> strand_offset(get_strand_count());
+        // Reads straight from the mapping (if any) so we only copy once.
+        std::vector<unsigned short> segments(get_segments().begin(), get_segments().end());
 
-        if (has_segments()) {
-            std::copy(segments.begin(), segments.end(), strand_offset.begin() + 1);
-            std::transform(strand_offset.begin(), strand_offset.end(),
-                           strand_offset.begin(), [](std::size_t i) { return i + 1; });
-            strand_offset[0] = 0;
-            std::partial_sum(strand_offset.begin(),
-                             strand_offset.end(),
-                             strand_offset.begin());
-        } else {
-            auto vertices_per_segment = get_default_segment_count() + 1;
-            std::fill(strand_offset.begin() + 1, strand_offset.end(), vertices_per_segment);
-            strand_offset[0] = 0;
-            std::partial_sum(strand_offset.begin(),
-                             strand_offset.end(),
-                             strand_offset.begin());
-        }
+        const auto vertices = get_vertices();
+        const auto thickness = get_thickness();
+        const auto tangents = get_tangents();
+        const auto transparency = get_transparency();
+        const auto color = get_color();
+
+        if (!strand_offsets_valid()) generate_strand_offsets();
+
+        // Strands are picked without replacement, so we need a copy here.
+        std::vector<std::size_t> strand_offset(strand_offsets.begin(), strand_offsets.end() - 1);
 
         while (--strands_left && strand_offset.size() != 0) {
             double random = xorshift64(&seed) / static_cast<double>(std::numeric_limits<std::uint64_t>::max());
@@ -437,24 +1722,487 @@ namespace vkhr {
             strand_offset.pop_back();
         }
 
-        segments = reduced_segments;
-        vertices = reduced_vertices;
+        release_mapping(); // Everything lives in vectors now.
+
+        this->segments = std::move(reduced_segments);
+        this->vertices = std::move(reduced_vertices);
 
+        generate_strand_offsets();
         generate_indices();
 
-        thickness = reduced_thickness;
-        tangents = reduced_tangents;
-        transparency = reduced_transparency;
-        color = reduced_color;
+        lod_chain.clear();
+        simplified_lods.clear();
+        guide_strands = GuideStrands { };
+
+        this->thickness = std::move(reduced_thickness);
+        this->tangents = std::move(reduced_tangents);
+        this->transparency = std::move(reduced_transparency);
+        this->color = std::move(reduced_color);
+    }
+
+    void HairStyle::build_lod_chain(unsigned lod_levels) {
+        if (!strand_offsets_valid()) generate_strand_offsets();
+
+        const std::size_t strand_count { get_strand_count() };
+
+        lod_levels = std::max(lod_levels, 1u);
+
+        auto morton_codes = create_root_morton_codes();
+
+        std::vector<std::uint64_t> sort_keys(strand_count);
+        for (std::size_t strand { 0 }; strand < strand_count; ++strand)
+            sort_keys[strand] = morton_codes[strand];
+
+        auto morton_order = sort_strands(sort_keys);
+
+        // Every run of lod_levels strands along the curve gives one strand
+        // to each level, in bit-reversed order, so the first few levels are
+        // spread out evenly. Inside the levels, strands are still in order.
+        auto level_of_residue = create_lod_residues(lod_levels);
+
+        for (std::size_t position { 0 }; position < strand_count; ++position) {
+            std::uint64_t level { level_of_residue[position % lod_levels] };
+            sort_keys[morton_order[position]] = level << 32 | morton_codes[morton_order[position]];
+        }
+
+        permute_strands(sort_strands(sort_keys));
+
+        generate_lod_chain(lod_levels);
+    }
+
+    void HairStyle::generate_lod_chain(unsigned lod_levels) {
+        if (!strand_offsets_valid()) generate_strand_offsets();
+
+        lod_levels = std::max(lod_levels, 1u);
+
+        const std::size_t strand_count   { get_strand_count() },
+                          segment_count  { get_segment_count() };
+
+        auto level_of_residue = create_lod_residues(lod_levels);
+
+        std::vector<std::size_t> level_sizes(lod_levels, 0);
+        for (unsigned residue { 0 }; residue < lod_levels && residue < strand_count; ++residue)
+            level_sizes[level_of_residue[residue]] = (strand_count - residue + lod_levels - 1) / lod_levels;
+
+        lod_chain.clear();
+
+        std::size_t strands { 0 };
+        for (unsigned level { 0 }; level < lod_levels; ++level) {
+            strands += level_sizes[level];
+
+            if (strands == 0) continue;
+
+            LevelOfDetail level_of_detail;
+            level_of_detail.strand_count  = static_cast<unsigned>(strands);
+            level_of_detail.segment_count = static_cast<unsigned>(strand_offsets[strands] - strands);
+            level_of_detail.strand_ratio  = strands / static_cast<float>(strand_count);
+
+            // Split evenly between both, so the coverage (thickness times
+            // opacity, for thin strands) stays the same as for all of them.
+            float segment_ratio { level_of_detail.segment_count / static_cast<float>(std::max<std::size_t>(segment_count, 1)) };
+            float compensation  { segment_ratio > 0.0f ? 1.0f / std::sqrt(segment_ratio) : 1.0f };
+
+            level_of_detail.thickness_scale  = compensation;
+            level_of_detail.opacity_exponent = compensation;
+
+            lod_chain.push_back(level_of_detail);
+        }
+    }
+
+    const std::vector<HairStyle::LevelOfDetail>& HairStyle::get_lod_chain() const {
+        return lod_chain;
+    }
+
+    HairStyle::LevelOfDetail HairStyle::get_level_of_detail(float strand_ratio) const {
+        if (lod_chain.empty()) {
+            strand_ratio = glm::clamp(strand_ratio, 0.0f, 1.0f);
+            return LevelOfDetail {
+                strand_ratio,
+                static_cast<unsigned>(get_strand_count()   * strand_ratio),
+                static_cast<unsigned>(get_segment_count() * strand_ratio),
+                1.0f, 1.0f
+            };
+        }
+
+        // Closest one, since they don't exactly line up with a strand_ratio.
+        auto closest = std::min_element(lod_chain.begin(), lod_chain.end(), [&](const auto& lhs, const auto& rhs) {
+            return std::abs(lhs.strand_ratio - strand_ratio) < std::abs(rhs.strand_ratio - strand_ratio);
+        });
+
+        return *closest;
+    }
+
+    unsigned HairStyle::SimplifiedStrands::get_segment_count(unsigned strand_count) const {
+        if (segment_offsets.empty()) return 0;
+        return segment_offsets[std::min<std::size_t>(strand_count, segment_offsets.size() - 1)];
+    }
+
+    std::size_t HairStyle::SimplifiedStrands::get_size() const {
+        return indices.size() * sizeof(indices[0]) +
+               segment_offsets.size() * sizeof(segment_offsets[0]);
+    }
+
+    HairStyle::SimplifiedStrands HairStyle::simplify(float max_error) const {
+        if (!strand_offsets_valid()) {
+            HairStyle hair_style { *this };
+            hair_style.generate_strand_offsets();
+            return hair_style.simplify(max_error);
+        }
+
+        const std::size_t strand_count { get_strand_count() };
+
+        const auto& offsets = strand_offsets;
+
+        const auto vertices = get_vertices();
+
+        std::vector<unsigned char> keep(get_vertex_count(), 0);
+
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int strand = 0; strand < static_cast<int>(strand_count); ++strand) {
+            const std::size_t begin { offsets[strand + 0] },
+                              end   { offsets[strand + 1] };
+            simplify_polyline(vertices.data() + begin, end - begin, max_error, keep.data() + begin);
+        }
+
+        SimplifiedStrands simplified;
+
+        simplified.max_error = max_error;
+        simplified.segment_offsets.resize(strand_count + 1, 0);
+
+        for (std::size_t strand { 0 }; strand < strand_count; ++strand) {
+            auto kept = std::count(keep.begin() + offsets[strand], keep.begin() + offsets[strand + 1], 1);
+            simplified.segment_offsets[strand + 1] = simplified.segment_offsets[strand] + static_cast<unsigned>(kept - 1);
+        }
+
+        simplified.indices.resize(simplified.segment_offsets.back() * 2);
+
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int strand = 0; strand < static_cast<int>(strand_count); ++strand) {
+            std::size_t index { 2 * static_cast<std::size_t>(simplified.segment_offsets[strand]) },
+                        previous { offsets[strand] };
+            for (std::size_t vertex { offsets[strand] + 1 }; vertex < offsets[strand + 1]; ++vertex) {
+                if (!keep[vertex]) continue;
+                simplified.indices[index++] = static_cast<unsigned>(previous);
+                simplified.indices[index++] = static_cast<unsigned>(vertex);
+                previous = vertex;
+            }
+        }
+
+        return simplified;
+    }
+
+    void HairStyle::set_simplified_lods(std::vector<SimplifiedStrands> simplified_strands) {
+        std::sort(simplified_strands.begin(), simplified_strands.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.max_error < rhs.max_error;
+        });
+
+        simplified_lods = std::move(simplified_strands);
+    }
+
+    const std::vector<HairStyle::SimplifiedStrands>& HairStyle::get_simplified_lods() const {
+        return simplified_lods;
+    }
+
+    HairStyle::GuideStrands HairStyle::create_guide_strands(unsigned guide_count, unsigned vertices_per_guide,
+                                                            unsigned iterations) const {
+        if (!strand_offsets_valid()) {
+            HairStyle hair_style { *this };
+            hair_style.generate_strand_offsets();
+            return hair_style.create_guide_strands(guide_count, vertices_per_guide, iterations);
+        }
+
+        const std::size_t strand_count { get_strand_count() };
+
+        const auto vertices = get_vertices();
+
+        vertices_per_guide = std::max(vertices_per_guide, 2u);
+        guide_count = std::min(guide_count, static_cast<unsigned>(strand_count));
+
+        GuideStrands guide_strands;
+        guide_strands.vertices_per_guide = vertices_per_guide;
+
+        if (guide_count == 0)
+            return guide_strands;
+
+        std::vector<glm::vec3> shapes(strand_count * vertices_per_guide);
+
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int strand = 0; strand < static_cast<int>(strand_count); ++strand) {
+            const std::size_t begin { strand_offsets[strand + 0] },
+                              end   { strand_offsets[strand + 1] };
+            resample_polyline(vertices.data() + begin, end - begin, vertices_per_guide,
+                              shapes.data() + strand * vertices_per_guide);
+        }
+
+        auto& guides = guide_strands.vertices;
+
+        guides.assign(shapes.begin(), shapes.begin() + guide_count * vertices_per_guide);
+
+        std::vector<unsigned> clusters(strand_count, 0);
+
+        for (unsigned iteration { 0 }; iteration < iterations; ++iteration) {
+            // The last cluster is a good bound to start with, and the roots
+            // come first, so most of the guides are rejected after one vertex.
+            #pragma omp parallel for schedule(dynamic, 256)
+            for (int strand = 0; strand < static_cast<int>(strand_count); ++strand) {
+                const glm::vec3* shape { shapes.data() + strand * vertices_per_guide };
+
+                unsigned closest { clusters[strand] };
+                float closest_distance { shape_distance(shape, guides.data() + closest * vertices_per_guide,
+                                                        vertices_per_guide, std::numeric_limits<float>::max()) };
+
+                for (unsigned guide { 0 }; guide < guide_count; ++guide) {
+                    float distance { shape_distance(shape, guides.data() + guide * vertices_per_guide,
+                                                    vertices_per_guide, closest_distance) };
+                    if (distance < closest_distance) {
+                        closest_distance = distance;
+                        closest = guide;
+                    }
+                }
+
+                clusters[strand] = closest;
+            }
+
+            std::vector<glm::vec3> shape_sums(guides.size(), glm::vec3 { 0.0f });
+            std::vector<unsigned> cluster_sizes(guide_count, 0);
+
+            for (std::size_t strand { 0 }; strand < strand_count; ++strand) {
+                auto cluster = clusters[strand];
+                ++cluster_sizes[cluster];
+                for (unsigned vertex { 0 }; vertex < vertices_per_guide; ++vertex)
+                    shape_sums[cluster * vertices_per_guide + vertex] += shapes[strand * vertices_per_guide + vertex];
+            }
+
+            // Guides without any strands left just stay where they were.
+            for (unsigned guide { 0 }; guide < guide_count; ++guide) {
+                if (cluster_sizes[guide] == 0) continue;
+                for (unsigned vertex { 0 }; vertex < vertices_per_guide; ++vertex)
+                    guides[guide * vertices_per_guide + vertex] = shape_sums[guide * vertices_per_guide + vertex]
+                                                                / static_cast<float>(cluster_sizes[guide]);
+            }
+        }
+
+        guide_strands.guides.resize(strand_count);
+        guide_strands.weights.resize(strand_count);
+        guide_strands.offsets.resize(strand_count);
+
+        constexpr unsigned guides_per_strand { GuideStrands::GuidesPerStrand };
+
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int strand = 0; strand < static_cast<int>(strand_count); ++strand) {
+            const glm::vec3* shape { shapes.data() + strand * vertices_per_guide };
+
+            std::array<unsigned, guides_per_strand> nearest;
+            std::array<float, guides_per_strand> nearest_distance;
+
+            nearest.fill(clusters[strand]);
+            nearest_distance.fill(std::numeric_limits<float>::max());
+
+            // Insertion sort, keeping the closest guides_per_strand guides.
+            for (unsigned guide { 0 }; guide < guide_count; ++guide) {
+                float distance { shape_distance(shape, guides.data() + guide * vertices_per_guide,
+                                                vertices_per_guide, nearest_distance.back()) };
+                if (distance >= nearest_distance.back()) continue;
+
+                unsigned i { guides_per_strand - 1 };
+                for (; i > 0 && nearest_distance[i - 1] > distance; --i) {
+                    nearest_distance[i] = nearest_distance[i - 1];
+                    nearest[i] = nearest[i - 1];
+                }
+
+                nearest_distance[i] = distance;
+                nearest[i] = guide;
+            }
+
+            // Inverse distance weighting, where missing guides get nothing.
+            glm::vec4 weights { 0.0f };
+            for (unsigned i { 0 }; i < guides_per_strand; ++i) {
+                if (nearest_distance[i] == std::numeric_limits<float>::max()) continue;
+                weights[i] = 1.0f / (nearest_distance[i] / vertices_per_guide + 1e-6f);
+            }
+
+            weights /= weights.x + weights.y + weights.z + weights.w;
+
+            glm::vec3 blended_root { 0.0f };
+            for (unsigned i { 0 }; i < guides_per_strand; ++i)
+                blended_root += weights[i] * guides[nearest[i] * vertices_per_guide];
+
+            guide_strands.guides[strand]  = glm::uvec4 { nearest[0], nearest[1], nearest[2], nearest[3] };
+            guide_strands.weights[strand] = weights;
+            guide_strands.offsets[strand] = shape[0] - blended_root;
+        }
+
+        return guide_strands;
+    }
+
+    const HairStyle::GuideStrands& HairStyle::get_guide_strands() const {
+        return guide_strands;
+    }
+
+    void HairStyle::set_guide_strands(GuideStrands guide_strands) {
+        this->guide_strands = std::move(guide_strands);
+    }
+
+    unsigned HairStyle::GuideStrands::get_guide_count() const {
+        if (vertices_per_guide == 0) return 0;
+        return static_cast<unsigned>(vertices.size() / vertices_per_guide);
+    }
+
+    std::size_t HairStyle::GuideStrands::get_size() const {
+        return vertices.size() * sizeof(vertices[0]) +
+               guides.size()   * sizeof(guides[0])   +
+               weights.size()  * sizeof(weights[0])  +
+               offsets.size()  * sizeof(offsets[0]);
+    }
+
+    glm::vec3 HairStyle::GuideStrands::interpolate(std::size_t strand, std::size_t vertex, std::size_t vertex_count) const {
+        float t { vertex_count > 1 ? static_cast<float>(vertex) / (vertex_count - 1) : 0.0f };
+
+        glm::vec3 position { offsets[strand] };
+        for (unsigned i { 0 }; i < GuidesPerStrand; ++i) {
+            const glm::vec3* guide { vertices.data() + guides[strand][i] * vertices_per_guide };
+            position += weights[strand][i] * sample_polyline(guide, vertices_per_guide, t);
+        }
+
+        return position;
+    }
+
+    std::vector<std::uint32_t> HairStyle::create_root_morton_codes() const {
+        const auto vertices = get_vertices();
+
+        const std::size_t strand_count { get_strand_count() };
+
+        glm::vec3 min_root {  std::numeric_limits<float>::max() },
+                  max_root { -std::numeric_limits<float>::max() };
+
+        for (std::size_t strand { 0 }; strand < strand_count; ++strand) {
+            min_root = glm::min(min_root, vertices[strand_offsets[strand]]);
+            max_root = glm::max(max_root, vertices[strand_offsets[strand]]);
+        }
+
+        glm::vec3 root_extent { glm::max(max_root - min_root, glm::vec3 { 1e-6f }) };
+
+        std::vector<std::uint32_t> morton_codes(strand_count);
+
+        #pragma omp parallel for schedule(static)
+        for (int strand = 0; strand < static_cast<int>(strand_count); ++strand) {
+            auto root = (vertices[strand_offsets[strand]] - min_root) / root_extent;
+            morton_codes[strand] = morton_code(root);
+        }
+
+        return morton_codes;
+    }
+
+    std::vector<unsigned> HairStyle::sort_strands(const std::vector<std::uint64_t>& sort_keys) {
+        std::vector<unsigned> order(sort_keys.size());
+        std::iota(order.begin(), order.end(), 0u);
+
+        // Ties are broken by the strand index to keep it deterministic.
+        std::sort(order.begin(), order.end(), [&](unsigned lhs, unsigned rhs) {
+            return sort_keys[lhs] < sort_keys[rhs] || (sort_keys[lhs] == sort_keys[rhs] && lhs < rhs);
+        });
+
+        return order;
+    }
+
+    std::vector<unsigned> HairStyle::create_lod_residues(unsigned lod_levels) {
+        unsigned bits { 0 };
+        while ((1u << bits) < lod_levels) ++bits;
+
+        auto bit_reverse = [bits](unsigned value) {
+            unsigned reversed { 0 };
+            for (unsigned bit { 0 }; bit < bits; ++bit)
+                reversed |= ((value >> bit) & 1u) << (bits - 1 - bit);
+            return reversed;
+        };
+
+        std::vector<unsigned> residues(lod_levels);
+        std::iota(residues.begin(), residues.end(), 0u);
+        std::sort(residues.begin(), residues.end(), [&](unsigned lhs, unsigned rhs) {
+            return bit_reverse(lhs) < bit_reverse(rhs);
+        });
+
+        // The residues[level] is its position in a run, but we want the
+        // level of a position, i.e. the inverse of this permutation here.
+        std::vector<unsigned> level_of_residue(lod_levels);
+        for (unsigned level { 0 }; level < lod_levels; ++level)
+            level_of_residue[residues[level]] = level;
+
+        return level_of_residue;
+    }
+
+    void HairStyle::permute_strands(const std::vector<unsigned>& order) {
+        const std::size_t strand_count { get_strand_count() };
+
+        std::vector<unsigned> reordered_offsets(strand_count + 1, 0);
+        for (std::size_t strand { 0 }; strand < strand_count; ++strand) {
+            auto old_strand = order[strand];
+            reordered_offsets[strand + 1] = reordered_offsets[strand] + strand_offsets[old_strand + 1]
+                                                                      - strand_offsets[old_strand];
+        }
+
+        // Moves all of the strand's vertices in the same way for any field.
+        auto permute = [&](const auto& field) {
+            using T = std::decay_t<decltype(field[0])>;
+            std::vector<T> reordered_field(field.size());
+            if (field.empty()) return reordered_field;
+
+            #pragma omp parallel for schedule(dynamic, 256)
+            for (int strand = 0; strand < static_cast<int>(strand_count); ++strand) {
+                auto old_strand = order[strand];
+                std::copy(field.begin() + strand_offsets[old_strand + 0],
+                          field.begin() + strand_offsets[old_strand + 1],
+                          reordered_field.begin() + reordered_offsets[strand]);
+            }
+
+            return reordered_field;
+        };
+
+        std::vector<unsigned short> reordered_segments;
+        if (has_segments()) {
+            const auto segments = get_segments();
+            reordered_segments.resize(strand_count);
+            for (std::size_t strand { 0 }; strand < strand_count; ++strand)
+                reordered_segments[strand] = segments[order[strand]];
+        }
+
+        auto reordered_vertices = permute(get_vertices());
+        auto reordered_thickness = permute(get_thickness());
+        auto reordered_tangents = permute(get_tangents());
+        auto reordered_transparency = permute(get_transparency());
+        auto reordered_color = permute(get_color());
+
+        bool had_indices { has_indices() };
+
+        release_mapping(); // Everything lives in vectors now.
+
+        this->segments = std::move(reordered_segments);
+        this->vertices = std::move(reordered_vertices);
+        this->thickness = std::move(reordered_thickness);
+        this->tangents = std::move(reordered_tangents);
+        this->transparency = std::move(reordered_transparency);
+        this->color = std::move(reordered_color);
+
+        strand_offsets = std::move(reordered_offsets);
+
+        // They refer to the old strand numbers.
+        strand_dirty.clear();
+        dirty_strands.clear();
+        simplified_lods.clear();
+        guide_strands = GuideStrands { };
+
+        if (had_indices) generate_indices();
     }
 
     std::vector<glm::vec4> HairStyle::create_position_thickness_data() const {
         std::vector<glm::vec4> position_thicknesses(get_vertex_count());
+        const auto vertices = get_vertices();
+        const auto thicknesses = get_thickness();
         #pragma omp parallel for schedule(dynamic)
         for (int i = 0; i < static_cast<int>(get_vertex_count()); ++i) {
             float thickness { 0.042f };
             if (has_thickness())
-                thickness = this->thickness[i];
+                thickness = thicknesses[i];
 
             position_thicknesses[i] = glm::vec4 {
                 vertices[i],
@@ -465,11 +2213,13 @@ namespace vkhr {
 
     std::vector<glm::vec4> HairStyle::create_tangent_transparency_data() const {
         std::vector<glm::vec4> tangent_transparency(get_vertex_count());
+        const auto tangents = get_tangents();
+        const auto transparencies = get_transparency();
         #pragma omp parallel for schedule(dynamic)
         for (int i = 0; i < static_cast<int>(get_vertex_count()); ++i) {
             float transparency { get_default_transparency() };
             if (has_transparency())
-                transparency = this->transparency[i];
+                transparency = transparencies[i];
 
             tangent_transparency[i] = glm::vec4 {
                 tangents[i],
@@ -480,16 +2230,18 @@ namespace vkhr {
 
     std::vector<glm::vec4> HairStyle::create_color_transparency_data() const {
         std::vector<glm::vec4> color_transparencies(get_vertex_count());
+        const auto transparencies = get_transparency();
+        const auto colors = get_color();
         #pragma omp parallel for schedule(dynamic)
         for (int i = 0; i < static_cast<int>(get_vertex_count()); ++i) {
             float transparency { get_default_transparency() };
             if (has_transparency()) {
-                transparency = this->transparency[i];
+                transparency = transparencies[i];
             }
 
             glm::vec3 color { get_default_color() };
             if (has_color()) {
-                color = this->color[i];
+                color = colors[i];
             }
 
             color_transparencies[i] = glm::vec4 {
@@ -499,31 +2251,38 @@ namespace vkhr {
         } return color_transparencies;
     }
 
-    const std::vector<unsigned>& HairStyle::get_indices() const {
+    Span<unsigned> HairStyle::get_indices() const {
+        if (!mapped_indices.empty()) return mapped_indices;
         return indices;
     }
 
-    const std::vector<glm::vec3>& HairStyle::get_tangents() const {
+    Span<glm::vec3> HairStyle::get_tangents() const {
+        if (!mapped_tangents.empty()) return mapped_tangents;
         return tangents;
     }
 
-    const std::vector<float>& HairStyle::get_thickness() const {
+    Span<float> HairStyle::get_thickness() const {
+        if (!mapped_thickness.empty()) return mapped_thickness;
         return thickness;
     }
 
-    const std::vector<glm::vec3>& HairStyle::get_vertices() const {
+    Span<glm::vec3> HairStyle::get_vertices() const {
+        if (!mapped_vertices.empty()) return mapped_vertices;
         return vertices;
     }
 
-    const std::vector<unsigned short>& HairStyle::get_segments() const {
+    Span<unsigned short> HairStyle::get_segments() const {
+        if (!mapped_segments.empty()) return mapped_segments;
         return segments;
     }
 
-    const std::vector<float>& HairStyle::get_transparency() const {
+    Span<float> HairStyle::get_transparency() const {
+        if (!mapped_transparency.empty()) return mapped_transparency;
         return transparency;
     }
 
-    const std::vector<glm::vec3>& HairStyle::get_color() const {
+    Span<glm::vec3> HairStyle::get_color() const {
+        if (!mapped_color.empty()) return mapped_color;
         return color;
     }
 
@@ -534,12 +2293,19 @@ namespace vkhr {
                file_header.signature[3] == 'R';
     }
 
+    bool HairStyle::compressed_signature() const {
+        return file_header.signature[0] == 'H' &&
+               file_header.signature[1] == 'A' &&
+               file_header.signature[2] == 'I' &&
+               file_header.signature[3] == 'Z';
+    }
+
     bool HairStyle::format_is_valid() const {
         if (!has_vertices()) return false;
         if (!valid_signature()) return false;
-        if (has_thickness() && thickness.size() != vertices.size()) return false;
-        if (has_transparency() && transparency.size() != vertices.size()) return false;
-        if (has_color() && color.size() != vertices.size()) return false;
+        if (has_thickness() && get_thickness().size() != get_vertex_count()) return false;
+        if (has_transparency() && get_transparency().size() != get_vertex_count()) return false;
+        if (has_color() && get_color().size() != get_vertex_count()) return false;
         return true; // The rest we assume is right. It's hard to verify.
     }
 
@@ -624,54 +2390,54 @@ namespace vkhr {
 
     bool HairStyle::write_segments(std::ofstream& file) const {
         if (file_header.field.has_segments) {
-            return write_field(file, segments);
+            return write_field(file, get_segments());
         } return true;
     }
 
     bool HairStyle::write_vertices(std::ofstream& file) const {
         if (file_header.field.has_vertices) {
-            return write_field(file, vertices);
+            return write_field(file, get_vertices());
         } return true;
     }
 
     bool HairStyle::write_thickness(std::ofstream& file) const {
         if (file_header.field.has_thickness) {
-            return write_field(file, thickness);
+            return write_field(file, get_thickness());
         } return true;
     }
 
     bool HairStyle::write_transparancy(std::ofstream& file) const {
         if (file_header.field.has_transparency) {
-            return write_field(file, transparency);
+            return write_field(file, get_transparency());
         } return true;
     }
 
     bool HairStyle::write_color(std::ofstream& file) const {
         if (file_header.field.has_color) {
-            return write_field(file, color);
+            return write_field(file, get_color());
         } return true;
     }
 
     bool HairStyle::write_tangents(std::ofstream& file) const {
         if (file_header.field.has_tangents) {
-            return write_field(file, tangents);
+            return write_field(file, get_tangents());
         } return true;
     }
 
     bool HairStyle::write_indices(std::ofstream& file) const {
         if (file_header.field.has_indices) {
-            return write_field(file, indices);
+            return write_field(file, get_indices());
         } return true;
     }
 
     std::size_t HairStyle::get_size() const {
         std::size_t size_in_bytes { 0 };
-        size_in_bytes += segments.size() * sizeof(segments[0]);
-        size_in_bytes += vertices.size() * sizeof(vertices[0]);
-        size_in_bytes += thickness.size() * sizeof(thickness[0]);
-        size_in_bytes += color.size() * sizeof(color[0]);
-        size_in_bytes += tangents.size() * sizeof(tangents[0]);
-        size_in_bytes += indices.size() * sizeof(indices[0]);
+        size_in_bytes += get_segments().size() * sizeof(segments[0]);
+        size_in_bytes += get_vertices().size() * sizeof(vertices[0]);
+        size_in_bytes += get_thickness().size() * sizeof(thickness[0]);
+        size_in_bytes += get_color().size() * sizeof(color[0]);
+        size_in_bytes += get_tangents().size() * sizeof(tangents[0]);
+        size_in_bytes += get_indices().size() * sizeof(indices[0]);
         size_in_bytes += sizeof(FileHeader);
         return size_in_bytes;
     }
@@ -283,6 +283,28 @@ namespace vkpp {
         swap(*this, buffer);
     }
 
+    VertexBuffer::VertexBuffer(Device& device,
+                               std::size_t vertex_count,
+                               VkDeviceSize vertex_size,
+                               std::uint32_t binding,
+                               const std::vector<Attribute> attributes)
+                              : DeviceBuffer { device,
+                                               vertex_size * vertex_count,
+                                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT } {
+        this->attributes.reserve(attributes.size());
+        for (const auto& attribute : attributes) {
+            this->attributes.push_back({ attribute.location,
+                                         binding,
+                                         attribute.format,
+                                         attribute.offset });
+        }
+
+        this->element_count = vertex_count;
+
+        this->binding = { binding, static_cast<std::uint32_t>(vertex_size), VK_VERTEX_INPUT_RATE_VERTEX };
+    }
+
     const VertexBuffer::Attributes& VertexBuffer::get_attributes() const {
         return attributes;
     }
@@ -302,13 +324,22 @@ namespace vkpp {
     IndexBuffer::IndexBuffer(Device& device,
                              CommandPool& command_pool,
                              const std::vector<unsigned>& indices)
+                            : IndexBuffer { device,
+                                            command_pool,
+                                            indices.data(),
+                                            indices.size() } {  }
+
+    IndexBuffer::IndexBuffer(Device& device,
+                             CommandPool& command_pool,
+                             const unsigned* indices,
+                             std::size_t index_count)
                             : DeviceBuffer { device,
                                              command_pool,
-                                             indices.data(),
-                                             sizeof(indices[0]) * indices.size(),
+                                             indices,
+                                             sizeof(unsigned) * index_count,
                                              VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT } {
-        this->element_count = indices.size();
+        this->element_count = index_count;
         this->index_type    = VK_INDEX_TYPE_UINT32;
     }
 
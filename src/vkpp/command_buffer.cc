@@ -113,6 +113,61 @@ namespace vkpp {
                        1, &blit_region, filter);
     }
 
+    void CommandBuffer::blit_mip_chain(Image& image, VkFilter filter) {
+        auto extent = image.get_extent();
+
+        auto get_level_size = [&](std::uint32_t level) {
+            return VkOffset3D { static_cast<std::int32_t>(std::max(extent.width  >> level, 1u)),
+                                static_cast<std::int32_t>(std::max(extent.height >> level, 1u)),
+                                static_cast<std::int32_t>(std::max(extent.depth  >> level, 1u)) };
+        };
+
+        for (std::uint32_t level { 1 }; level < image.get_mip_levels(); ++level) {
+            if (level > 1) {
+                VkImageMemoryBarrier barrier {  };
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.pNext = nullptr;
+
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+                barrier.oldLayout = image.get_layout();
+                barrier.newLayout = image.get_layout();
+
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+                barrier.image = image.get_handle();
+
+                barrier.subresourceRange.aspectMask = image.get_aspect_mask();
+                barrier.subresourceRange.baseMipLevel = level - 1;
+                barrier.subresourceRange.levelCount = 1;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount = 1;
+
+                pipeline_barrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 barrier);
+            }
+
+            VkImageBlit blit_region {  };
+
+            blit_region.srcSubresource.aspectMask = image.get_aspect_mask();
+            blit_region.srcSubresource.mipLevel = level - 1;
+            blit_region.srcSubresource.layerCount = 1;
+            blit_region.srcOffsets[1] = get_level_size(level - 1);
+
+            blit_region.dstSubresource.aspectMask = image.get_aspect_mask();
+            blit_region.dstSubresource.mipLevel = level;
+            blit_region.dstSubresource.layerCount = 1;
+            blit_region.dstOffsets[1] = get_level_size(level);
+
+            vkCmdBlitImage(handle, image.get_handle(), image.get_layout(),
+                           image.get_handle(), image.get_layout(),
+                           1, &blit_region, filter);
+        }
+    }
+
     void CommandBuffer::copy_image(Image& source, Image& destination) {
         VkImageCopy copy_region {  };
 
@@ -163,6 +218,27 @@ namespace vkpp {
                         1, &buffer_copy);
     }
 
+    void CommandBuffer::copy_buffer(Buffer& source, Buffer& destination,
+                                    const std::vector<VkBufferCopy>& regions) {
+        if (regions.empty())
+            return;
+
+        vkCmdCopyBuffer(handle,
+                        source.get_handle(), destination.get_handle(),
+                        static_cast<std::uint32_t>(regions.size()), regions.data());
+    }
+
+    void CommandBuffer::copy_buffer_image(Buffer& source, Image& destination,
+                                          const std::vector<VkBufferImageCopy>& regions) {
+        if (regions.empty())
+            return;
+
+        vkCmdCopyBufferToImage(handle,
+                               source.get_handle(), destination.get_handle(),
+                               destination.get_layout(),
+                               static_cast<std::uint32_t>(regions.size()), regions.data());
+    }
+
     void CommandBuffer::copy_buffer_image(Buffer& source, Image& destination) {
         VkBufferImageCopy region;
 
@@ -184,6 +260,32 @@ namespace vkpp {
                                1, &region);
     }
 
+    void CommandBuffer::copy_buffer_image(Buffer& source, Image& destination,
+                                          VkDeviceSize offset, std::uint32_t mip_level) {
+        VkBufferImageCopy region;
+
+        region.bufferOffset = offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mip_level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+
+        auto extent = destination.get_extent();
+
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { std::max(extent.width  >> mip_level, 1u),
+                               std::max(extent.height >> mip_level, 1u),
+                               std::max(extent.depth  >> mip_level, 1u) };
+
+        vkCmdCopyBufferToImage(handle,
+                               source.get_handle(), destination.get_handle(),
+                               destination.get_layout(),
+                               1, &region);
+    }
+
     void CommandBuffer::begin_render_pass(RenderPass& render_pass,
                                           vkhr::vulkan::DepthMap& depth_map) {
         VkRenderPassBeginInfo begin_info;
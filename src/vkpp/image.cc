@@ -7,13 +7,14 @@
 
 #include <vkpp/exception.hh>
 
+#include <algorithm>
 #include <utility>
 
 namespace vkpp {
     Image::Image(Device& logical_device, std::uint32_t width, std::uint32_t height,
                  std::uint32_t depth, VkFormat format, VkImageUsageFlags usage,
                  std::uint32_t mip_levels, VkSampleCountFlagBits samples,
-                 VkImageTiling tiling_mode)
+                 VkImageTiling tiling_mode, VkImageCreateFlags flags)
                 : layout { VK_IMAGE_LAYOUT_UNDEFINED },
                   tiling_mode { tiling_mode },
                   sharing_mode { VK_SHARING_MODE_EXCLUSIVE },
@@ -21,7 +22,7 @@ namespace vkpp {
         VkImageCreateInfo create_info;
         create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         create_info.pNext = nullptr;
-        create_info.flags = 0;
+        create_info.flags = flags;
 
         if (depth == 1) {
             create_info.imageType = VK_IMAGE_TYPE_2D;
@@ -214,7 +215,7 @@ namespace vkpp {
         barrier.subresourceRange.aspectMask = get_aspect_mask();
 
         barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.levelCount = mip_levels;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = 1;
 
@@ -269,7 +270,7 @@ namespace vkpp {
         barrier.subresourceRange.aspectMask = get_aspect_mask();
 
         barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.levelCount = mip_levels;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = 1;
 
@@ -517,7 +518,8 @@ namespace vkpp {
                              std::uint32_t width, std::uint32_t height, std::uint32_t depth,
                              CommandPool& command_pool,
                              std::vector<glm::i8vec4>& volume,
-                             std::uint32_t mip_levels)
+                             std::uint32_t mip_levels,
+                             Residency residency)
                             : Image { device,
                                       width,
                                       height,
@@ -528,7 +530,15 @@ namespace vkpp {
                                       VK_IMAGE_USAGE_STORAGE_BIT,
                                       mip_levels,
                                       VK_SAMPLE_COUNT_1_BIT,
-                                      VK_IMAGE_TILING_OPTIMAL } {
+                                      VK_IMAGE_TILING_OPTIMAL,
+                                      residency == Residency::Sparse ? SparseFlags : 0 } {
+        if (residency == Residency::Sparse) {
+            sparse_upload(device, command_pool,
+                          { reinterpret_cast<const unsigned char*>(volume.data()) },
+                          sizeof(volume[0]));
+            return;
+        }
+
         staging_buffer = Buffer {
             device,
             volume.size() * sizeof(volume[0]),
@@ -576,6 +586,314 @@ namespace vkpp {
                                 .wait_idle();
     }
 
+    DeviceImage::DeviceImage(Device& device,
+                             std::uint32_t width, std::uint32_t height, std::uint32_t depth,
+                             CommandPool& command_pool,
+                             std::vector<std::vector<unsigned char>>& volume_mip_chain,
+                             Residency residency)
+                            : Image { device,
+                                      width,
+                                      height,
+                                      depth,
+                                      VK_FORMAT_R8_UNORM,
+                                      VK_IMAGE_USAGE_SAMPLED_BIT |
+                                      VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                                      VK_IMAGE_USAGE_STORAGE_BIT,
+                                      static_cast<std::uint32_t>(volume_mip_chain.size()),
+                                      VK_SAMPLE_COUNT_1_BIT,
+                                      VK_IMAGE_TILING_OPTIMAL,
+                                      residency == Residency::Sparse ? SparseFlags : 0 } {
+        if (residency == Residency::Sparse) {
+            std::vector<const unsigned char*> levels;
+            for (auto& level : volume_mip_chain)
+                levels.push_back(level.data());
+            sparse_upload(device, command_pool, levels, sizeof(unsigned char));
+            return;
+        }
+
+        // Buffer to image copies need their offsets to be 4-byte aligned.
+        std::vector<VkDeviceSize> offsets;
+        VkDeviceSize size { 0 };
+        for (auto& level : volume_mip_chain) {
+            offsets.push_back(size);
+            size += (level.size() + 3) & ~VkDeviceSize { 3 };
+        }
+
+        staging_buffer = Buffer {
+            device,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+        };
+
+        auto staging_memory_requirements = staging_buffer.get_memory_requirements();
+
+        staging_memory = DeviceMemory {
+            device,
+            staging_memory_requirements,
+            DeviceMemory::Type::HostVisible
+        };
+
+        staging_buffer.bind(staging_memory);
+
+        for (std::size_t level { 0 }; level < volume_mip_chain.size(); ++level) {
+            staging_memory.copy(volume_mip_chain[level].size(),
+                                volume_mip_chain[level].data(),
+                                offsets[level]);
+        }
+
+        auto image_memory_requirements = get_memory_requirements();
+
+        device_memory = DeviceMemory {
+            device,
+            image_memory_requirements,
+            DeviceMemory::Type::DeviceLocal
+        };
+
+        bind(device_memory);
+
+        auto command_buffer = command_pool.allocate_and_begin();
+
+        transition(command_buffer, VK_IMAGE_LAYOUT_UNDEFINED,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        for (std::uint32_t level { 0 }; level < mip_levels; ++level) {
+            command_buffer.copy_buffer_image(staging_buffer, *this,
+                                             offsets[level], level);
+        }
+
+        transition(command_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        command_buffer.end();
+
+        command_pool.get_queue().submit(command_buffer)
+                                .wait_idle();
+    }
+
+    bool DeviceImage::sparse_residency_supported(Device& device, CommandPool& command_pool,
+                                                 VkFormat format, VkImageUsageFlags usage) {
+        const auto& enabled_features = device.get_enabled_features();
+
+        if (!enabled_features.sparseBinding || !enabled_features.sparseResidencyImage3D)
+            return false;
+
+        auto& physical_device = device.get_physical_device();
+
+        if (!physical_device.get_properties().sparseProperties.residencyNonResidentStrict)
+            return false;
+
+        auto queue_family = command_pool.get_queue().get_family_index();
+        if (!(physical_device.get_queue_family_properties()[queue_family].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT))
+            return false;
+
+        std::uint32_t property_count { 0 };
+        vkGetPhysicalDeviceSparseImageFormatProperties(physical_device.get_handle(), format,
+                                                       VK_IMAGE_TYPE_3D, VK_SAMPLE_COUNT_1_BIT,
+                                                       usage, VK_IMAGE_TILING_OPTIMAL,
+                                                       &property_count, nullptr);
+
+        return property_count != 0;
+    }
+
+    void DeviceImage::sparse_upload(Device& device, CommandPool& command_pool,
+                                    const std::vector<const unsigned char*>& levels,
+                                    VkDeviceSize texel_size) {
+        auto memory_requirements = get_memory_requirements();
+
+        std::uint32_t requirement_count { 0 };
+        vkGetImageSparseMemoryRequirements(this->device, handle, &requirement_count, nullptr);
+        std::vector<VkSparseImageMemoryRequirements> sparse_requirements(requirement_count);
+        vkGetImageSparseMemoryRequirements(this->device, handle, &requirement_count, sparse_requirements.data());
+
+        auto color_requirements = std::find_if(sparse_requirements.begin(), sparse_requirements.end(),
+                                               [](const VkSparseImageMemoryRequirements& requirements) {
+                                                   return requirements.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT;
+                                               });
+
+        if (color_requirements == sparse_requirements.end()) {
+            throw Exception { "couldn't bind sparse image memory!",
+                              "no sparse memory requirements for the color aspect!" };
+        }
+
+        auto align = [](VkDeviceSize size, VkDeviceSize alignment) {
+            return (size + alignment - 1) / alignment * alignment;
+        };
+
+        const auto& granularity = color_requirements->formatProperties.imageGranularity;
+
+        VkDeviceSize block_size { align(granularity.width * granularity.height * granularity.depth * texel_size,
+                                        memory_requirements.alignment) };
+
+        // Levels from here on are packed together, and bound as one piece.
+        std::uint32_t mip_tail_level { std::min(color_requirements->imageMipTailFirstLod, mip_levels) };
+
+        std::vector<VkSparseImageMemoryBind> block_binds;
+        std::vector<VkBufferImageCopy> block_copies;
+        std::vector<unsigned char> staging_data;
+
+        auto get_level_extent = [&](std::uint32_t level) {
+            return VkExtent3D { std::max(extent.width  >> level, 1u),
+                                std::max(extent.height >> level, 1u),
+                                std::max(extent.depth  >> level, 1u) };
+        };
+
+        auto add_copy = [&](std::uint32_t level, VkOffset3D offset, VkExtent3D copy_extent) {
+            VkBufferImageCopy copy {  };
+
+            copy.bufferOffset = staging_data.size();
+
+            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy.imageSubresource.mipLevel = level;
+            copy.imageSubresource.layerCount = 1;
+
+            copy.imageOffset = offset;
+            copy.imageExtent = copy_extent;
+
+            auto level_extent = get_level_extent(level);
+
+            for (std::uint32_t z { 0 }; z < copy_extent.depth;  ++z)
+            for (std::uint32_t y { 0 }; y < copy_extent.height; ++y) {
+                auto row = levels[level] + ((offset.z + z) * level_extent.height * level_extent.width +
+                                            (offset.y + y) * level_extent.width + offset.x) * texel_size;
+                staging_data.insert(staging_data.end(), row, row + copy_extent.width * texel_size);
+            }
+
+            // Buffer to image copies need their offsets to be 4-byte aligned.
+            staging_data.resize(align(staging_data.size(), 4), 0);
+
+            block_copies.push_back(copy);
+        };
+
+        for (std::uint32_t level { 0 }; level < mip_tail_level; ++level) {
+            auto level_extent = get_level_extent(level);
+
+            for (std::uint32_t z { 0 }; z < level_extent.depth;  z += granularity.depth)
+            for (std::uint32_t y { 0 }; y < level_extent.height; y += granularity.height)
+            for (std::uint32_t x { 0 }; x < level_extent.width;  x += granularity.width) {
+                VkExtent3D block_extent { std::min(granularity.width,  level_extent.width  - x),
+                                          std::min(granularity.height, level_extent.height - y),
+                                          std::min(granularity.depth,  level_extent.depth  - z) };
+
+                bool empty { true };
+
+                for (std::uint32_t block_z { 0 }; block_z < block_extent.depth  && empty; ++block_z)
+                for (std::uint32_t block_y { 0 }; block_y < block_extent.height && empty; ++block_y) {
+                    auto row = levels[level] + ((z + block_z) * level_extent.height * level_extent.width +
+                                                (y + block_y) * level_extent.width + x) * texel_size;
+                    empty = std::all_of(row, row + block_extent.width * texel_size,
+                                        [](unsigned char byte) { return byte == 0; });
+                }
+
+                if (empty) continue;
+
+                VkSparseImageMemoryBind block_bind {  };
+
+                block_bind.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                block_bind.subresource.mipLevel = level;
+
+                block_bind.offset = { static_cast<std::int32_t>(x),
+                                      static_cast<std::int32_t>(y),
+                                      static_cast<std::int32_t>(z) };
+                block_bind.extent = block_extent;
+
+                block_bind.memoryOffset = block_binds.size() * block_size;
+
+                block_binds.push_back(block_bind);
+
+                add_copy(level, block_bind.offset, block_extent);
+            }
+        }
+
+        VkSparseMemoryBind mip_tail_bind {  };
+
+        VkDeviceSize memory_size { block_binds.size() * block_size };
+
+        if (mip_tail_level < mip_levels) {
+            mip_tail_bind.resourceOffset = color_requirements->imageMipTailOffset;
+            mip_tail_bind.size = color_requirements->imageMipTailSize;
+            mip_tail_bind.memoryOffset = memory_size;
+
+            memory_size += align(mip_tail_bind.size, memory_requirements.alignment);
+
+            for (std::uint32_t level { mip_tail_level }; level < mip_levels; ++level)
+                add_copy(level, { 0, 0, 0 }, get_level_extent(level));
+        }
+
+        auto command_buffer = command_pool.allocate_and_begin();
+
+        transition(command_buffer, VK_IMAGE_LAYOUT_UNDEFINED,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        if (memory_size != 0) {
+            memory_requirements.size = memory_size;
+
+            device_memory = DeviceMemory {
+                device,
+                memory_requirements,
+                DeviceMemory::Type::DeviceLocal
+            };
+
+            memory = device_memory.get_handle();
+
+            for (auto& block_bind : block_binds)
+                block_bind.memory = memory;
+            mip_tail_bind.memory = memory;
+
+            VkSparseImageMemoryBindInfo block_bind_info;
+            block_bind_info.image = handle;
+            block_bind_info.bindCount = static_cast<std::uint32_t>(block_binds.size());
+            block_bind_info.pBinds = block_binds.data();
+
+            VkSparseImageOpaqueMemoryBindInfo mip_tail_bind_info;
+            mip_tail_bind_info.image = handle;
+            mip_tail_bind_info.bindCount = 1;
+            mip_tail_bind_info.pBinds = &mip_tail_bind;
+
+            VkBindSparseInfo bind_info {  };
+            bind_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+            bind_info.pNext = nullptr;
+
+            bind_info.imageBindCount = block_binds.empty() ? 0 : 1;
+            bind_info.pImageBinds = &block_bind_info;
+            bind_info.imageOpaqueBindCount = mip_tail_level < mip_levels ? 1 : 0;
+            bind_info.pImageOpaqueBinds = &mip_tail_bind_info;
+
+            command_pool.get_queue().bind_sparse(bind_info)
+                                    .wait_idle();
+
+            staging_buffer = Buffer {
+                device,
+                staging_data.size(),
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+            };
+
+            auto staging_memory_requirements = staging_buffer.get_memory_requirements();
+
+            staging_memory = DeviceMemory {
+                device,
+                staging_memory_requirements,
+                DeviceMemory::Type::HostVisible
+            };
+
+            staging_buffer.bind(staging_memory);
+            staging_memory.copy(staging_data.size(), staging_data.data());
+
+            vkCmdCopyBufferToImage(command_buffer.get_handle(),
+                                   staging_buffer.get_handle(), handle,
+                                   layout,
+                                   static_cast<std::uint32_t>(block_copies.size()),
+                                   block_copies.data());
+        }
+
+        transition(command_buffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        command_buffer.end();
+
+        command_pool.get_queue().submit(command_buffer)
+                                .wait_idle();
+    }
+
     void DeviceImage::staged_copy(vkhr::Image& image, CommandBuffer& command_buffer) {
         staging_memory.copy(image.get_size_in_bytes(), image.get_data());
 
@@ -616,7 +934,8 @@ namespace vkpp {
                         : layout { final_layout }, device { device }, handle { image_view } { }
 
     ImageView::ImageView(Device& logical_device, Image& real_image,
-                         VkImageLayout final_layout)
+                         VkImageLayout final_layout,
+                         std::uint32_t mip_levels)
                         : layout { final_layout },
                           image { real_image.get_handle() },
                           device { logical_device.get_handle() } {
@@ -642,7 +961,7 @@ namespace vkpp {
 
         create_info.subresourceRange.aspectMask = real_image.get_aspect_mask();
         create_info.subresourceRange.baseMipLevel = 0;
-        create_info.subresourceRange.levelCount = 1;
+        create_info.subresourceRange.levelCount = mip_levels;
         create_info.subresourceRange.baseArrayLayer = 0;
         create_info.subresourceRange.layerCount = 1;
 
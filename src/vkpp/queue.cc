@@ -115,6 +115,14 @@ namespace vkpp {
         return *this;
     }
 
+    Queue& Queue::bind_sparse(const VkBindSparseInfo& bind_info) {
+        if (VkResult error = vkQueueBindSparse(handle, 1, &bind_info, VK_NULL_HANDLE)) {
+            throw Exception { error, "couldn't bind sparse memory on the queue!" };
+        }
+
+        return *this;
+    }
+
     Queue& Queue::wait_idle() {
         vkQueueWaitIdle(handle);
         return *this;